@@ -51,6 +51,28 @@
 //		- trace until register holds value
 //		- trace until any register holds value
 //		- visually track eip
+//	-	19.10.2026
+//		- optional recording of the traced path
+//		  (and register deltas) into a compact
+//		  trace file, see tools/eptq.cpp
+//		- ui feedback (current address, "Track
+//		  Eip") is refreshed by a timer at a
+//		  limited rate instead of on every step
+//		- new mode which runs all OEP heuristics
+//		  in one trace and ranks the candidates
+//		- registers are read once per step and
+//		  shared by all conditions
+//		- new mode: trace until any register
+//		  points to a string (native version of
+//		  dbgext/lm.idc)
+//		- tracer statistics: events/sec and a
+//		  latency histogram of the debugger, the
+//		  conditions, get_reg_val() and the ui.
+//		  Dumped when the tracer stops, or on
+//		  demand by running the plugin with
+//		  argument 1 (see plugins.cfg)
+//		- new mode: trace until EIP enters a page
+//		  that was written during the trace
 //
 //
 //	(c) 2004, Dennis Elser
@@ -58,19 +80,37 @@
 //////////////////////////////////////////////////
 
 
+#include <windows.h>
+
 #include <ida.hpp>
 #include <idp.hpp>
 #include <loader.hpp>
 #include <kernwin.hpp>
 #include <dbg.hpp>
 
+#include "epf.hpp"
+#include "recorder.hpp"
+#include "oep.hpp"
+#include "lmwatch.hpp"
+#include "stats.hpp"
+#include "wwatch.hpp"
+
 #define MAX_STR 260
 
+//ui feedback during tracing
+#define UI_MAX_RATE		50			//refreshes per second
+#define UI_STATS_INTERVAL	5000		//ms between two "steps/sec" messages
+
 
 //function prototype(s)
 ea_t get_reg_val(char *regname);
 void toggle_tracer(void);
 void set_tracer_internal_state(bool state);
+void record_step(const ea_t *regs);
+void ui_start_updates(void);
+void ui_stop_updates(void);
+void tracer_stopped(void);
+void stop_mode(void);
 //-------------------------------------------------------------
 
 
@@ -78,12 +118,10 @@ void set_tracer_internal_state(bool state);
 const char *onoff[]={"off","on"};
 const char *registers[]={"eax","ebx","ecx","edx","esi","edi","ebp","esp","eip"};
 const short CHKBX_0001 = 0x0001;        // First Check Box
-/*
 const short CHKBX_0002 = 0x0002;        // Second Check Box
 const short CHKBX_0003 = 0x0004;        // Third Check Box
 const short CHKBX_0004 = 0x0008;        // Fourth Check Box
 const short CHKBX_0005 = 0x0010;
-*/
 
 //The dialogs were made with the help of
 //J.C.Roberts' excellent examples, thanks you!
@@ -118,7 +156,16 @@ const char dlg[] =
     "Trace until a register holds a specific value:R>"
 
     "<#Please enter a value below.#"               // hint radio1
-    "Trace until any register holds a specific value:R>>\n\n\n\n\n\n\n"
+    "Trace until any register holds a specific value:R>"
+
+    "<#Runs all OEP heuristics at once and ranks the candidates.#"
+    "Trace until an OEP candidate reaches the score threshold:R>"
+
+    "<#Please enter a string below. ASCII and Unicode are checked.#"
+    "Trace until any register points to a specific string:R>"
+
+    "<#Stops when EIP enters a page written by the traced code (or found changed by a page hash).#"
+    "Trace until EIP reaches memory written during the trace:R>>\n\n\n\n\n\n\n\n\n\n"
 
 	"<#Enter an *exact* mnemonic-string here.#"
 	"Mnemonic :A:255:32:::>\n"                      // text radio1
@@ -129,8 +176,29 @@ const char dlg[] =
 	"<#Enter a value here.#"
 	"Value    :A:255:32:::>\n"                      // text radio1
 
+	"<#Enter the string to look for here.#"
+	"String   :A:255:32:::>\n"
+
+	"<#How often per second the current address (and 'Track Eip') is updated.#"
+	"UI updates/sec :D:4:4::>\n"
+
+	"<#Score an OEP candidate needs (section 30, popad 30, stack 25, written 35, decoded 30).#"
+	"Threshold      :D:4:4::>\n"
+
 	"<#Tracking Eip gives a nice visual effect but slows down!#"
-	"Track Eip           :C>>\n\n"
+	"Track Eip           :C>\n"
+
+	"<#Writes every traced EIP to a compact trace file.#"
+	"Record trace        :C>\n"
+
+	"<#Also records the general purpose registers (needs 'Record trace').#"
+	"Record registers    :C>\n"
+
+	"<#Suspend the process at the first candidate reaching the threshold, otherwise only report it.#"
+	"Stop at OEP candidate :C>\n"
+
+	"<#Suspend the process when a register points to the string, otherwise only log it.#"
+	"Stop at string hit    :C>>\n\n"
 
     ; // End Dialog Format String
 //-------------------------------------------------------------
@@ -150,7 +218,29 @@ char reg[MAX_STR]="eax";
 char value[MAX_STR]="0xDEADBEEF";
 
 ea_t reg_val;
+int reg_idx=-1;		//index into registers[], -1 if not in the table
 bool b_trackEip=false;
+sval_t ui_rate=10;
+
+sval_t oep_threshold=OEP_DEFAULT_THRESHOLD;
+bool b_oepStop=true;
+
+char lmstr[MAX_STR]="PWD";
+bool b_lmStop=true;
+
+//state of the ui updater, the tracer only
+//stores the current eip and counts steps
+UINT_PTR ui_timer=0;
+ea_t ui_eip=BADADDR;
+ulong ui_steps=0;
+ulong ui_stats_steps=0;
+DWORD ui_start_tick=0;
+DWORD ui_stats_tick=0;
+DWORD ui_last_tick=0;
+
+bool b_record=false;
+bool b_recordRegs=false;
+char tracefile[MAXSTR];
 
 //-------------------------------------------------------------
 
@@ -159,18 +249,43 @@ bool b_trackEip=false;
 void toggle_tracer(void)
 {
 	char *segname;
+	char *answer;
 	short checkbox;
+	ea_t regs[REG_QTY];
+	int i;
 
 	if(!b_switch)
 	{
-		checkbox = (short)(b_trackEip * CHKBX_0001);
-		if ( AskUsingForm_c(dlg,&status,&mnem, &reg, &value, &checkbox) == 0)
+		checkbox = (short)(b_trackEip * CHKBX_0001 |
+						   b_record * CHKBX_0002 |
+						   b_recordRegs * CHKBX_0003 |
+						   b_oepStop * CHKBX_0004 |
+						   b_lmStop * CHKBX_0005);
+		if ( AskUsingForm_c(dlg,&status,&mnem, &reg, &value, &lmstr, &ui_rate, &oep_threshold, &checkbox) == 0)
 		{
 			msg("-> EPF: aborted.\n");
 			return;
 		}
 		
 		b_trackEip = (bool)(checkbox & CHKBX_0001);
+		if(ui_rate < 1) ui_rate = 1;
+		if(ui_rate > UI_MAX_RATE) ui_rate = UI_MAX_RATE;
+		b_record = (bool)(checkbox & CHKBX_0002);
+		b_recordRegs = (bool)(checkbox & CHKBX_0003);
+		b_oepStop = (bool)(checkbox & CHKBX_0004);
+		b_lmStop = (bool)(checkbox & CHKBX_0005);
+
+		//ask before any mode is started, so cancelling leaves nothing behind
+		if(b_record)
+		{
+			answer = askfile_c(1,"*.ept","Enter a filename for the trace:");
+			if(answer == NULL)
+			{
+				msg("-> EPF: aborted.\n");
+				return;
+			}
+			qstrncpy(tracefile,answer,sizeof(tracefile));
+		}
 
 		switch(status)
 		{
@@ -204,11 +319,43 @@ void toggle_tracer(void)
 				msg("-> EPF: %s is not a valid value (use \"0x\" for HEX values)!\n",value);
 				return;
 			}
+			reg_idx = -1;
+			for(i=0;i<REG_QTY;i++)
+			{
+				if(stricmp(reg, registers[i]) == 0)
+					reg_idx = i;
+			}
+			break;
+		case 5:
+			read_regs(regs);
+			oep_start(regs,oep_threshold);
+			break;
+		case 6:
+			if(!lm_start(lmstr, LM_DEFAULT_LEVEL))
+				return;
+			break;
+		case 7:
+			read_regs(regs);
+			if(!ww_start(regs))
+				return;
 			break;
 		}
+
+		if(b_record && !rec_start(tracefile,b_recordRegs))
+		{
+			stop_mode();
+			return;
+		}
 		
 	}
 	b_switch^=1;
+	if(b_switch)
+	{
+		stats_reset();
+		ui_start_updates();
+	}
+	else
+		tracer_stopped();
 	enable_step_trace(b_switch);
 	msg("-> EPF is now %s\n",onoff[b_switch]);
 	if( b_switch ) msg ("-> EPF: Please resume the process now!\n");
@@ -219,11 +366,33 @@ void toggle_tracer(void)
 void set_tracer_internal_state(bool state)
 {
 	b_switch=state;
+	if(!b_switch) tracer_stopped();
 	msg("-> EPF is now %s\n",onoff[b_switch]);
 }
 //-------------------------------------------------------------
 
 
+//stops what toggle_tracer() started for the current mode
+void stop_mode(void)
+{
+	if(status == 5) oep_stop();
+	if(status == 6) lm_stop();
+	if(status == 7) ww_stop();
+}
+//-------------------------------------------------------------
+
+
+//finishes whatever the current mode has started
+void tracer_stopped(void)
+{
+	ui_stop_updates();
+	rec_stop();
+	stop_mode();
+	stats_dump();
+}
+//-------------------------------------------------------------
+
+
 //(personal comment)
 //dbg.hpp has the following function, which I might use
 //in future versions of this plugin
@@ -231,28 +400,161 @@ void set_tracer_internal_state(bool state)
 ea_t get_reg_val(char *regname)
 {
 	regval_t eip;
+	uint64 t = stats_now();
 	get_reg_val(regname,&eip);
+	stats_add(ST_GETREG, stats_now() - t);
 	return eip.ival;
 }
 //-------------------------------------------------------------
 
 
+//reads eax..esp and eip into regs[REG_QTY]
+void read_regs(ea_t *regs)
+{
+	int i;
+
+	for(i=0;i<REG_QTY;i++)
+		regs[i] = get_reg_val((char *)registers[i]);
+}
+//-------------------------------------------------------------
+
+
+//shows the address the tracer is at and,
+//every few seconds, how fast it is going
+void ui_refresh(void)
+{
+	DWORD now = GetTickCount();
+	DWORD elapsed;
+	uint64 t = stats_now();
+
+	ui_last_tick = now;
+	if(ui_eip != BADADDR)
+	{
+		if (b_trackEip) jumpto(ui_eip);
+		showAddr(ui_eip);
+	}
+
+	elapsed = now - ui_stats_tick;
+	if(elapsed >= UI_STATS_INTERVAL)
+	{
+		msg("-> EPF: %u steps, %u steps/sec\n",
+			ui_steps,
+			(ulong)((ui_steps - ui_stats_steps) * 1000.0 / elapsed));
+		ui_stats_steps = ui_steps;
+		ui_stats_tick = now;
+	}
+	stats_add(ST_UI, stats_now() - t);
+}
+//-------------------------------------------------------------
+
+
+//the timer fires on ida's ui thread between two debug events
+static void CALLBACK ui_timer_proc(HWND /*hwnd*/, UINT /*msg*/, UINT_PTR /*id*/, DWORD /*time*/)
+{
+	ui_refresh();
+}
+//-------------------------------------------------------------
+
+
+void ui_start_updates(void)
+{
+	ui_eip = BADADDR;
+	ui_steps = ui_stats_steps = 0;
+	ui_start_tick = ui_stats_tick = ui_last_tick = GetTickCount();
+	if(ui_timer == 0)
+		ui_timer = SetTimer(NULL, 0, 1000 / ui_rate, ui_timer_proc);
+}
+//-------------------------------------------------------------
+
+
+void ui_stop_updates(void)
+{
+	DWORD elapsed;
+
+	if(ui_timer == 0)
+		return;
+	KillTimer(NULL, ui_timer);
+	ui_timer = 0;
+
+	//last position and summary
+	ui_refresh();
+	elapsed = GetTickCount() - ui_start_tick;
+	msg("-> EPF: traced %u steps in %u.%03u sec (%u steps/sec)\n",
+		ui_steps, elapsed / 1000, elapsed % 1000,
+		elapsed ? (ulong)(ui_steps * 1000.0 / elapsed) : ui_steps);
+}
+//-------------------------------------------------------------
+
+
+//appends the current step to the trace file
+void record_step(const ea_t *regs)
+{
+	ept_state_t s;
+	int i;
+
+	s.eip = regs[REG_EIP];
+	if(rec_regs())
+	{
+		for(i=0;i<EPT_NREGS;i++)
+			s.regs[i] = regs[i];
+	}
+	else
+		memset(s.regs,0,sizeof(s.regs));
+	rec_add(s);
+}
+//-------------------------------------------------------------
+
+
+//true if the current mode needs all registers
+bool need_regs(void)
+{
+	return status >= 3 || rec_regs();
+}
+//-------------------------------------------------------------
+
+
 static int idaapi dbg_callback(void * /*user_data*/, int event_id, va_list /*va*/)
 {
 	ea_t eip;
+	ea_t regs[REG_QTY];
+	char *segname;
+	uint64 t;
 	int i;
 
 	if(!b_switch) return 0;
 	
 	if(event_id==dbg_trace)
 	{
-		eip = get_reg_val("eip");
-		if (b_trackEip) jumpto(eip);
-		showAddr(eip);
+		stats_event_begin();
+
+		//read the registers once, all conditions share them
+		if (need_regs())
+			read_regs(regs);
+		else
+			regs[REG_EIP] = get_reg_val("eip");
+		eip = regs[REG_EIP];
+
+		if (rec_active())
+		{
+			t = stats_now();
+			record_step(regs);
+			stats_add(ST_RECORD, stats_now() - t);
+		}
+
+		//no ui work here, the timer picks this up. If the
+		//timer is starved by a busy message queue, refresh
+		//from here at half the rate
+		ui_eip = eip;
+		ui_steps++;
+		if ( GetTickCount() - ui_last_tick > 2000 / (DWORD)ui_rate )
+			ui_refresh();
+
+		t = stats_now();
 		switch(status)
 		{
 		case 0:
-			if( strcmp(seg, get_segm_name(get_reg_val("eip"))) != 0 )
+			segname = get_segm_name(eip);
+			if( segname == NULL || strcmp(seg, segname) != 0 )
 			{
 				msg("-> EPF: EIP is pointing into a different section at: %08X.\n",eip);
 				suspend_process();
@@ -280,7 +582,9 @@ static int idaapi dbg_callback(void * /*user_data*/, int event_id, va_list /*va*
 			}
 			break;
 		case 3:
-			if( reg_val == get_reg_val(reg) )
+			//registers which are not part of the snapshot
+			//(flags, segment registers..) are read directly
+			if( reg_val == (reg_idx >= 0 ? regs[reg_idx] : get_reg_val(reg)) )
 			{
 				msg("-> EPF: %s == %08X at %08X.\n",reg, reg_val, eip);
 				suspend_process();
@@ -288,17 +592,42 @@ static int idaapi dbg_callback(void * /*user_data*/, int event_id, va_list /*va*
 			}
 			break;
 		case 4:
-			for(i=0;i<9;i++)
+			for(i=0;i<REG_QTY;i++)
 			{
-				if( reg_val == get_reg_val((char *)registers[i]) )
+				if( reg_val == regs[i] )
 				{
 					msg("-> EPF: %s == %08X at %08X.\n",registers[i], reg_val, eip);
 					suspend_process();
 					toggle_tracer();
+					break;
 				}
 			}
 			break;
+		case 5:
+			if( oep_step(regs) != BADADDR && b_oepStop )
+			{
+				suspend_process();
+				toggle_tracer();
+			}
+			break;
+		case 6:
+			if( lm_step(regs) && b_lmStop )
+			{
+				msg("-> EPF: a register points to \"%s\" at %08X.\n", lmstr, eip);
+				suspend_process();
+				toggle_tracer();
+			}
+			break;
+		case 7:
+			if( ww_step(regs) )
+			{
+				suspend_process();
+				toggle_tracer();
+			}
+			break;
 		}
+		stats_add(ST_COND, stats_now() - t);
+		stats_event_end();
 	}
 	else if(event_id==dbg_process_exit)
 	{
@@ -325,12 +654,21 @@ int idaapi init(void)
 
 void idaapi term(void)
 {
+	ui_stop_updates();
+	rec_stop();
 	//unregister callback
 	unhook_from_notification_point(HT_DBG, dbg_callback);
 }
 
 void idaapi run(int arg)
 {
+	//plugins.cfg entry with argument 1 -> show statistics
+	if(arg == 1)
+	{
+		stats_dump();
+		return;
+	}
+
 	//is_debugger_on(void) ?
 	if(get_process_state() == 0)
 	{
@@ -345,7 +683,8 @@ void idaapi run(int arg)
 //-------------------------------------------------------------
 
 char comment[] = "Entry point finder plugin for IDA PRO";
-char help[] = "This plugin can find the entry point of packed executables.\n";
+char help[] = "This plugin can find the entry point of packed executables.\n"
+			 "Run it with argument 1 to show the tracer statistics.\n";
 char wanted_name[] = "Toggle EPF tracer on or off";
 char wanted_hotkey[] = "Alt-7";
 
@@ -0,0 +1,34 @@
+//////////////////////////////////////////////////
+//
+//  epf.hpp - declarations shared by the EPF
+//  source files
+//
+//////////////////////////////////////////////////
+
+#ifndef __EPF_HPP
+#define __EPF_HPP
+
+//indices into a register snapshot,
+//same order as the registers[] table
+enum
+{
+	REG_EAX,
+	REG_EBX,
+	REG_ECX,
+	REG_EDX,
+	REG_ESI,
+	REG_EDI,
+	REG_EBP,
+	REG_ESP,
+	REG_EIP,
+	REG_QTY
+};
+
+#define PAGE_SIZE	0x1000
+#define PAGE_SHIFT	12
+
+extern const char *registers[];
+
+void read_regs(ea_t *regs);
+
+#endif // __EPF_HPP
@@ -0,0 +1,343 @@
+//////////////////////////////////////////////////
+//
+//  eptrace.hpp - EPF execution trace file format
+//
+//  -------------------------------------------
+//
+//	A trace file consists of a 32 byte file
+//	header followed by self-contained blocks.
+//	Every block starts with a summary (first
+//	step, number of records, lowest and highest
+//	EIP, mask of registers that changed) and the
+//	register state the block was encoded against.
+//	Readers can therefore skip whole blocks
+//	without decoding them.
+//
+//	Records are delta-encoded against the
+//	previous record:
+//
+//	  varint  zigzag(eip - prev_eip)
+//	  uchar   mask of changed registers  (*)
+//	  varint  zigzag(reg - prev_reg)     (*)
+//	          for each bit set in mask
+//
+//	(*) only present if EPT_FLAG_REGS is set
+//
+//	All integers are stored little endian.
+//	This header is shared by the plugin and
+//	the offline query tool (tools/eptq.cpp),
+//	so it must not depend on the IDA SDK.
+//
+//////////////////////////////////////////////////
+
+#ifndef __EPTRACE_HPP
+#define __EPTRACE_HPP
+
+#include <string.h>
+
+typedef unsigned char ept_u8;
+typedef unsigned int ept_u32;
+typedef unsigned long long ept_u64;
+
+#define EPT_MAGIC			"EPFTRACE"
+#define EPT_VERSION			1
+#define EPT_FLAG_REGS		0x0001
+
+// general purpose registers recorded along with EIP,
+// same order as the registers[] table in epf.cpp
+#define EPT_NREGS			8
+
+#define EPT_HDR_SIZE		32
+#define EPT_BLK_MAGIC		0x424C5445		// "ETLB"
+#define EPT_BLK_HDR_SIZE	(32 + 4 + 4*EPT_NREGS)
+
+// a block is sealed as soon as it holds EPT_BLK_RECORDS
+// records or the payload cannot take another record
+#define EPT_BLK_RECORDS		16384
+#define EPT_BLK_PAYLOAD		65536
+#define EPT_MAX_RECORD		(5 + 1 + 5*EPT_NREGS)
+
+static const char * const ept_regnames[EPT_NREGS] =
+{
+	"eax","ebx","ecx","edx","esi","edi","ebp","esp"
+};
+
+//-------------------------------------------------------------
+
+struct ept_state_t
+{
+	ept_u32 eip;
+	ept_u32 regs[EPT_NREGS];
+};
+
+struct ept_header_t
+{
+	ept_u32 version;
+	ept_u32 flags;
+	ept_u32 nregs;
+	ept_u32 blk_records;
+};
+
+struct ept_block_t
+{
+	ept_u32 payload_size;
+	ept_u64 first_step;
+	ept_u32 count;
+	ept_u32 eip_min;
+	ept_u32 eip_max;
+	ept_u32 regmask;		// OR of all record masks
+	ept_state_t base;		// state before the first record
+};
+
+//-------------------------------------------------------------
+
+inline void ept_put32(ept_u8 *p, ept_u32 v)
+{
+	p[0] = (ept_u8)v;
+	p[1] = (ept_u8)(v >> 8);
+	p[2] = (ept_u8)(v >> 16);
+	p[3] = (ept_u8)(v >> 24);
+}
+
+inline ept_u32 ept_get32(const ept_u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((ept_u32)p[3] << 24);
+}
+
+inline void ept_put64(ept_u8 *p, ept_u64 v)
+{
+	ept_put32(p, (ept_u32)v);
+	ept_put32(p+4, (ept_u32)(v >> 32));
+}
+
+inline ept_u64 ept_get64(const ept_u8 *p)
+{
+	return ept_get32(p) | ((ept_u64)ept_get32(p+4) << 32);
+}
+
+inline ept_u32 ept_zigzag(ept_u32 delta)
+{
+	return (delta << 1) ^ (ept_u32)((int)delta >> 31);
+}
+
+inline ept_u32 ept_unzigzag(ept_u32 v)
+{
+	return (v >> 1) ^ (ept_u32)-(int)(v & 1);
+}
+
+inline ept_u8 *ept_put_varint(ept_u8 *p, ept_u32 v)
+{
+	while ( v >= 0x80 )
+	{
+		*p++ = (ept_u8)(v | 0x80);
+		v >>= 7;
+	}
+	*p++ = (ept_u8)v;
+	return p;
+}
+
+// returns NULL if the varint runs past 'end'
+inline const ept_u8 *ept_get_varint(const ept_u8 *p, const ept_u8 *end, ept_u32 *v)
+{
+	ept_u32 r = 0;
+	for ( int shift=0; shift < 35; shift += 7 )
+	{
+		if ( p >= end )
+			return NULL;
+		ept_u8 b = *p++;
+		r |= (ept_u32)(b & 0x7F) << shift;
+		if ( (b & 0x80) == 0 )
+		{
+			*v = r;
+			return p;
+		}
+	}
+	return NULL;
+}
+
+//-------------------------------------------------------------
+
+inline void ept_write_header(ept_u8 *out, const ept_header_t &h)
+{
+	memset(out, 0, EPT_HDR_SIZE);
+	memcpy(out, EPT_MAGIC, 8);
+	ept_put32(out+8,  h.version);
+	ept_put32(out+12, h.flags);
+	ept_put32(out+16, h.nregs);
+	ept_put32(out+20, h.blk_records);
+}
+
+inline bool ept_read_header(const ept_u8 *in, ept_header_t *h)
+{
+	if ( memcmp(in, EPT_MAGIC, 8) != 0 )
+		return false;
+	h->version     = ept_get32(in+8);
+	h->flags       = ept_get32(in+12);
+	h->nregs       = ept_get32(in+16);
+	h->blk_records = ept_get32(in+20);
+	return h->version == EPT_VERSION && h->nregs == EPT_NREGS;
+}
+
+inline void ept_write_block_header(ept_u8 *out, const ept_block_t &b)
+{
+	ept_put32(out,    EPT_BLK_MAGIC);
+	ept_put32(out+4,  b.payload_size);
+	ept_put64(out+8,  b.first_step);
+	ept_put32(out+16, b.count);
+	ept_put32(out+20, b.eip_min);
+	ept_put32(out+24, b.eip_max);
+	ept_put32(out+28, b.regmask);
+	ept_put32(out+32, b.base.eip);
+	for ( int i=0; i < EPT_NREGS; i++ )
+		ept_put32(out+36+4*i, b.base.regs[i]);
+}
+
+inline bool ept_read_block_header(const ept_u8 *in, ept_block_t *b)
+{
+	if ( ept_get32(in) != EPT_BLK_MAGIC )
+		return false;
+	b->payload_size = ept_get32(in+4);
+	b->first_step   = ept_get64(in+8);
+	b->count        = ept_get32(in+16);
+	b->eip_min      = ept_get32(in+20);
+	b->eip_max      = ept_get32(in+24);
+	b->regmask      = ept_get32(in+28);
+	b->base.eip     = ept_get32(in+32);
+	for ( int i=0; i < EPT_NREGS; i++ )
+		b->base.regs[i] = ept_get32(in+36+4*i);
+	return b->payload_size <= EPT_BLK_PAYLOAD;
+}
+
+//-------------------------------------------------------------
+// Encodes records into the payload area of one block.
+// The caller provides the payload buffer (usually a slot
+// of the recorder's ring buffer) and seals the block with
+// ept_write_block_header() once full() returns true.
+class ept_encoder_t
+{
+	ept_u8 *payload;
+	ept_u8 *ptr;
+	bool regs;
+	bool started;
+	ept_state_t prev;
+
+public:
+	ept_block_t blk;
+
+	ept_encoder_t(void) : payload(NULL), ptr(NULL), regs(false), started(false)
+	{
+		memset(&prev, 0, sizeof(prev));
+		memset(&blk, 0, sizeof(blk));
+	}
+
+	void start(ept_u8 *buf, ept_u64 first_step, bool with_regs)
+	{
+		payload = ptr = buf;
+		regs = with_regs;
+		blk.payload_size = 0;
+		blk.first_step = first_step;
+		blk.count = 0;
+		blk.eip_min = 0xFFFFFFFF;
+		blk.eip_max = 0;
+		blk.regmask = 0;
+		blk.base = prev;
+	}
+
+	bool full(void) const
+	{
+		return blk.count >= EPT_BLK_RECORDS
+			|| (ptr - payload) + EPT_MAX_RECORD > EPT_BLK_PAYLOAD;
+	}
+
+	bool empty(void) const { return blk.count == 0; }
+
+	void add(const ept_state_t &s)
+	{
+		// the very first record is encoded against itself
+		if ( !started )
+		{
+			prev = s;
+			blk.base = s;
+			started = true;
+		}
+		ptr = ept_put_varint(ptr, ept_zigzag(s.eip - prev.eip));
+		if ( regs )
+		{
+			ept_u8 *pmask = ptr++;
+			ept_u8 mask = 0;
+			for ( int i=0; i < EPT_NREGS; i++ )
+			{
+				if ( s.regs[i] != prev.regs[i] )
+				{
+					mask |= (ept_u8)(1 << i);
+					ptr = ept_put_varint(ptr, ept_zigzag(s.regs[i] - prev.regs[i]));
+				}
+			}
+			*pmask = mask;
+			blk.regmask |= mask;
+		}
+		if ( s.eip < blk.eip_min ) blk.eip_min = s.eip;
+		if ( s.eip > blk.eip_max ) blk.eip_max = s.eip;
+		blk.count++;
+		blk.payload_size = (ept_u32)(ptr - payload);
+		prev = s;
+	}
+};
+
+//-------------------------------------------------------------
+// Walks the records of a single block
+class ept_decoder_t
+{
+	const ept_u8 *ptr;
+	const ept_u8 *end;
+	ept_u32 left;
+	bool regs;
+
+public:
+	ept_state_t cur;
+	ept_u64 step;		// step number of 'cur'
+	ept_u32 changed;	// registers changed by the last record
+
+	void start(const ept_block_t &b, const ept_u8 *payload, bool with_regs)
+	{
+		ptr = payload;
+		end = payload + b.payload_size;
+		left = b.count;
+		regs = with_regs;
+		cur = b.base;
+		step = b.first_step - 1;
+		changed = 0;
+	}
+
+	// returns false at the end of the block or on corrupt data
+	bool next(void)
+	{
+		ept_u32 v;
+
+		if ( left == 0 )
+			return false;
+		if ( (ptr = ept_get_varint(ptr, end, &v)) == NULL )
+			return false;
+		cur.eip += ept_unzigzag(v);
+		changed = 0;
+		if ( regs )
+		{
+			if ( ptr >= end )
+				return false;
+			changed = *ptr++;
+			for ( int i=0; i < EPT_NREGS; i++ )
+			{
+				if ( (changed & (1 << i)) == 0 )
+					continue;
+				if ( (ptr = ept_get_varint(ptr, end, &v)) == NULL )
+					return false;
+				cur.regs[i] += ept_unzigzag(v);
+			}
+		}
+		left--;
+		step++;
+		return true;
+	}
+};
+
+#endif // __EPTRACE_HPP
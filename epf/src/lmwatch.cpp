@@ -0,0 +1,353 @@
+//////////////////////////////////////////////////
+//
+//  lmwatch.cpp - EPF string watch
+//
+//  -------------------------------------------
+//
+//	Native version of dbgext/lm.idc (LawnMower).
+//	After each step every general purpose
+//	register is checked for pointing to the
+//	user's string, ASCII or UTF-16, up to
+//	'level' pointers deep:
+//
+//	  level 0:   reg -> string
+//	  level 1:   reg -> ptr -> string
+//
+//	Memory is read through a small page cache.
+//	A cached page is dropped when a traced
+//	instruction writes to it (including pushes
+//	to the stack), when a call/int was stepped
+//	over without being traced, or when it gets
+//	too old (other threads may write as well).
+//
+//	Hits are appended to <database>.lm.csv:
+//	step,eip,register,level,address,encoding,disasm
+//
+//////////////////////////////////////////////////
+
+#include <emmintrin.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <bytes.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <intel.hpp>
+
+#include "epf.hpp"
+#include "oep.hpp"
+#include "lmwatch.hpp"
+
+#define CACHE_PAGES		16		//direct mapped, must be a power of 2
+#define CACHE_MAX_AGE	4096	//steps
+#define MAX_STR_LEN		260
+#define MAX_NEEDLE		(2*MAX_STR_LEN)
+
+#define PAGE(ea)		((ea) & ~(PAGE_SIZE-1))
+#define SLOT(ea)		(((ea) >> PAGE_SHIFT) & (CACHE_PAGES-1))
+
+struct cache_page_t
+{
+	ea_t page;			//BADADDR if unused
+	ulong stamp;		//step at which it was read
+	bool readable;
+	uchar data[PAGE_SIZE];
+};
+
+static cache_page_t *cache = NULL;
+static ulong steps;
+static ulong hits;
+static ulong misses;
+
+static uchar needle[2][MAX_NEEDLE];	//ASCII and UTF-16LE form
+static size_t needle_len[2];
+static const char *enc_names[2] = { "ascii", "utf16" };
+static int max_level;
+
+static ea_t pending_write;
+static asize_t pending_size;
+static ea_t prev_next;
+static bool prev_stepover;
+static bool prev_pushes;
+
+static FILE *logfile = NULL;
+static char logname[QMAXPATH];
+static ulong logged;
+//-------------------------------------------------------------
+
+
+static void invalidate(ea_t ea)
+{
+	cache_page_t &c = cache[SLOT(ea)];
+	if( c.page == PAGE(ea) )
+		c.page = BADADDR;
+}
+
+static void invalidate_all(void)
+{
+	for( int i=0; i<CACHE_PAGES; i++ )
+		cache[i].page = BADADDR;
+}
+
+static const cache_page_t *get_page(ea_t ea)
+{
+	cache_page_t &c = cache[SLOT(ea)];
+
+	if( c.page == PAGE(ea) && steps - c.stamp < CACHE_MAX_AGE )
+		return &c;
+
+	misses++;
+	c.page = PAGE(ea);
+	c.stamp = steps;
+	invalidate_dbgmem_contents(c.page, PAGE_SIZE);
+	c.readable = get_many_bytes(c.page, c.data, PAGE_SIZE);
+	return &c;
+}
+
+//copies 'size' bytes at 'ea' through the cache
+static bool read_mem(ea_t ea, uchar *buf, size_t size)
+{
+	while( size != 0 )
+	{
+		const cache_page_t *c = get_page(ea);
+		size_t off = ea & (PAGE_SIZE-1);
+		size_t n = PAGE_SIZE - off;
+		if( !c->readable )
+			return false;
+		if( n > size )
+			n = size;
+		memcpy(buf, c->data + off, n);
+		buf += n;
+		ea += (ea_t)n;
+		size -= n;
+	}
+	return true;
+}
+//-------------------------------------------------------------
+
+
+//compares 16 bytes at a time
+static bool mem_equal(const uchar *a, const uchar *b, size_t len)
+{
+	while( len >= 16 )
+	{
+		__m128i x = _mm_loadu_si128((const __m128i *)a);
+		__m128i y = _mm_loadu_si128((const __m128i *)b);
+		if( _mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF )
+			return false;
+		a += 16;
+		b += 16;
+		len -= 16;
+	}
+	return len == 0 || memcmp(a, b, len) == 0;
+}
+
+//returns 0 (ascii) or 1 (utf16) if 'ea' points to the string, -1 otherwise
+static int match_at(ea_t ea)
+{
+	uchar buf[MAX_NEEDLE];
+	const uchar *p;
+
+	//most registers don't point to readable memory
+	const cache_page_t *c = get_page(ea);
+	if( !c->readable )
+		return -1;
+
+	for( int i=0; i<2; i++ )
+	{
+		size_t len = needle_len[i];
+		size_t off = ea & (PAGE_SIZE-1);
+
+		//cheap reject on the first byte
+		if( c->data[off] != needle[i][0] )
+			continue;
+
+		if( off + len <= PAGE_SIZE )
+			p = c->data + off;
+		else if( read_mem(ea, buf, len) )
+			p = buf;
+		else
+			continue;
+
+		if( mem_equal(p, needle[i], len) )
+			return i;
+	}
+	return -1;
+}
+//-------------------------------------------------------------
+
+
+bool lm_start(const char *str, int level)
+{
+	size_t len = strlen(str);
+	size_t i;
+
+	if( len == 0 || len > MAX_STR_LEN )
+	{
+		msg("-> EPF: the string must have 1..%d characters.\n", MAX_STR_LEN);
+		return false;
+	}
+
+	memcpy(needle[0], str, len);
+	for( i=0; i<len; i++ )
+	{
+		needle[1][2*i] = (uchar)str[i];
+		needle[1][2*i+1] = 0;
+	}
+	needle_len[0] = len;
+	needle_len[1] = 2*len;
+	max_level = level < 0 ? 0 : level;
+
+	if( cache == NULL )
+		cache = (cache_page_t *)malloc(sizeof(cache_page_t) * CACHE_PAGES);
+	if( cache == NULL )
+		return false;
+	invalidate_all();
+
+	steps = hits = misses = logged = 0;
+	pending_size = 0;
+	prev_next = BADADDR;
+	prev_stepover = prev_pushes = false;
+
+	set_file_ext(logname, sizeof(logname), database_idb, "lm.csv");
+	logfile = qfopen(logname, "a");
+	if( logfile == NULL )
+	{
+		msg("-> EPF: could not open %s\n", logname);
+		return false;
+	}
+	qfseek(logfile, 0, SEEK_END);
+	if( qftell(logfile) == 0 )
+		qfputs("step,eip,register,level,address,encoding,disasm\n", logfile);
+
+	msg("-> EPF: watching for \"%s\", hits go to %s\n", str, logname);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+static void log_hit(ea_t eip, int reg, int level, ea_t addr, int enc)
+{
+	char line[MAXSTR];
+	char disasm[MAXSTR];
+	char *p;
+
+	if( generate_disasm_line(eip, line, sizeof(line)) )
+		tag_remove(line, disasm, sizeof(disasm));
+	else
+		disasm[0] = '\0';
+
+	//csv quoting
+	for( p=disasm; *p != '\0'; p++ )
+		if( *p == '"' ) *p = '\'';
+
+	qfprintf(logfile, "%u,%08X,%s,%d,%08X,%s,\"%s\"\n",
+		steps, eip, registers[reg], level, addr, enc_names[enc], disasm);
+	logged++;
+}
+//-------------------------------------------------------------
+
+
+//called for every traced step, returns true
+//if any register points to the string
+bool lm_step(const ea_t *regs)
+{
+	ea_t eip = regs[REG_EIP];
+	ea_t esp = regs[REG_ESP];
+	bool found = false;
+	int size;
+
+	steps++;
+
+	//drop pages the last instruction may have changed
+	if( prev_stepover && eip == prev_next )
+		invalidate_all();
+	if( pending_size != 0 )
+	{
+		//stop at the last page, the end address wraps to 0
+		//for a write at the top of the address space
+		ea_t last = PAGE(pending_write + pending_size - 1);
+		for( ea_t page=PAGE(pending_write); ; page += PAGE_SIZE )
+		{
+			invalidate(page);
+			if( page == last )
+				break;
+		}
+		pending_size = 0;
+	}
+	if( prev_pushes )
+	{
+		invalidate(esp);
+		invalidate(esp + 32);
+	}
+
+	for( int r=0; r<REG_EIP; r++ )
+	{
+		ea_t ptr = regs[r];
+		for( int level=0; level <= max_level; level++ )
+		{
+			int enc = match_at(ptr);
+			if( enc >= 0 )
+			{
+				log_hit(eip, r, level, ptr, enc);
+				found = true;
+				break;
+			}
+			uint32 next;
+			if( level == max_level || !read_mem(ptr, (uchar *)&next, sizeof(next)) )
+				break;
+			ptr = next;
+		}
+	}
+	if( found )
+		hits++;
+
+	//see what the instruction about to execute will write
+	size = ua_ana0(eip);
+	prev_next = size != 0 ? eip + size : BADADDR;
+	prev_stepover = prev_pushes = false;
+	if( size != 0 )
+	{
+		switch( cmd.itype )
+		{
+		case NN_push:
+		case NN_pusha:
+		case NN_pushad:
+		case NN_pushf:
+		case NN_pushfd:
+		case NN_enter:
+			prev_pushes = true;
+			break;
+		case NN_call:
+		case NN_callfi:
+		case NN_callni:
+			prev_pushes = true;
+			prev_stepover = true;
+			break;
+		case NN_int:
+		case NN_into:
+		case NN_sysenter:
+		case NN_syscall:
+			prev_stepover = true;
+			break;
+		}
+		if( get_insn_write(regs, &pending_write, &pending_size) )
+		{
+			if( pending_write + pending_size < pending_write )
+				pending_size = 0 - pending_write;
+		}
+	}
+	return found;
+}
+//-------------------------------------------------------------
+
+
+void lm_stop(void)
+{
+	if( logfile == NULL )
+		return;
+	qfclose(logfile);
+	logfile = NULL;
+	msg("-> EPF: %u steps with string hits, %u lines written to %s (%u cache misses)\n",
+		hits, logged, logname, misses);
+}
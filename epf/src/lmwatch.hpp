@@ -0,0 +1,23 @@
+//////////////////////////////////////////////////
+//
+//  lmwatch.hpp - EPF string watch
+//
+//  -------------------------------------------
+//
+//	Native version of dbgext/lm.idc (LawnMower):
+//	checks after each step if a register points
+//	(directly or through 'level' pointers) to a
+//	user supplied string, ASCII or UTF-16.
+//
+//////////////////////////////////////////////////
+
+#ifndef __LMWATCH_HPP
+#define __LMWATCH_HPP
+
+#define LM_DEFAULT_LEVEL	1
+
+bool lm_start(const char *str, int level);
+bool lm_step(const ea_t *regs);
+void lm_stop(void);
+
+#endif // __LMWATCH_HPP
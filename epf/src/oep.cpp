@@ -0,0 +1,491 @@
+//////////////////////////////////////////////////
+//
+//  oep.cpp - EPF OEP scoring engine
+//
+//  -------------------------------------------
+//
+//	Instead of betting a whole trace on a
+//	single heuristic, all detectors watch the
+//	same trace. They are evaluated whenever
+//	EIP does not simply fall through to the
+//	next instruction (a "transfer") and the
+//	target lies within a segment of the input
+//	file. Each detector that fires adds its
+//	weight to the score of the target address
+//	(once per detector and address).
+//
+//	detectors:
+//	- section hop: the target is in another
+//	  section of the image than the code that
+//	  was running at trace start
+//	- pushad/popad: the transfer follows a
+//	  popad that restored the frame of an
+//	  earlier pushad
+//	- stack restore: the transfer follows esp
+//	  returning to its value at trace start
+//	- written jump: the target page was written
+//	  by a traced instruction
+//	- decoded: the target page had a high
+//	  entropy at trace start (packed data) and
+//	  now looks like code
+//
+//////////////////////////////////////////////////
+
+#include <math.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <bytes.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <intel.hpp>
+
+#include <map>
+#include <vector>
+#include <algorithm>
+
+#include "epf.hpp"
+#include "oep.hpp"
+#include "pagemap.hpp"
+
+//weights, in the order of the OEP_xxx bits
+static const int weights[OEP_DETECTORS] = { 30, 30, 25, 35, 30 };
+static const char *detector_names[OEP_DETECTORS] =
+{
+	"section", "popad", "stack", "written", "decoded"
+};
+
+//popad and esp restore count for transfers
+//within this many steps
+#define ARMED_STEPS		32
+
+//entropy (bits per byte) of packed and of decoded pages
+#define ENTROPY_PACKED	7.0
+#define ENTROPY_DECODED	6.0
+
+//upper limit for a single (rep stos/movs) write
+#define MAX_WRITE		(16*1024*1024)
+
+#define PAGE(ea)		((ea) & ~(PAGE_SIZE-1))
+
+struct candidate_t
+{
+	ea_t ea;
+	int score;
+	int detectors;
+	ulong step;			//step at which it was seen first
+	ulong hits;
+	bool reported;
+};
+
+static std::map<ea_t, candidate_t> candidates;
+static std::vector<candidate_t> ranked;
+static pagemap_t written_pages;
+static std::map<ea_t, bool> packed_pages;	//page -> decoded (fired once)
+
+static int threshold = OEP_DEFAULT_THRESHOLD;
+static ulong steps;
+static ea_t prev_eip;
+static ea_t prev_next;
+static ea_t entry_seg;
+static ea_t entry_esp;
+static bool stack_dipped;
+static int popad_armed;
+static int stack_armed;
+static std::vector<ea_t> pushad_esp;
+static ea_t pending_write;
+static asize_t pending_size;
+
+static const char title[] = "EPF - OEP candidates";
+static const char *header[] = { "Address", "Score", "Detectors", "Segment", "Step" };
+static const int widths[] = { 10, 6, 32, 10, 10 };
+//-------------------------------------------------------------
+
+
+//intel.hpp register numbers -> register snapshot
+static ea_t reg_value(const ea_t *regs, int r)
+{
+	static const int map[8] =
+	{
+		REG_EAX, REG_ECX, REG_EDX, REG_EBX,
+		REG_ESP, REG_EBP, REG_ESI, REG_EDI
+	};
+	return ( r >= 0 && r < 8 ) ? regs[map[r]] : 0;
+}
+
+static ea_t get_op_address(const ea_t *regs, const op_t &x)
+{
+	ea_t ea;
+
+	if( x.type == o_mem )
+		return x.addr;
+
+	ea = ( x.type == o_displ ) ? x.addr : 0;
+	if( hasSIB(x) )
+	{
+		ea += reg_value(regs, sib_base(x));
+		if( sib_index(x) != R_sp )
+			ea += reg_value(regs, sib_index(x)) << sib_scale(x);
+	}
+	else
+		ea += reg_value(regs, x.phrase);
+	return ea;
+}
+//-------------------------------------------------------------
+
+
+//returns the memory the instruction in 'cmd' is about to
+//write to. Implicit stack writes (push, call..) are ignored,
+//so are fs/gs relative accesses.
+bool get_insn_write(const ea_t *regs, ea_t *ea, asize_t *size)
+{
+	static const int chg[2] = { CF_CHG1, CF_CHG2 };
+
+	if( cmd.segpref == R_fs || cmd.segpref == R_gs )
+		return false;
+
+	for( int i=0; i<2; i++ )
+	{
+		const op_t &x = cmd.Operands[i];
+		if( x.type != o_mem && x.type != o_phrase && x.type != o_displ )
+			continue;
+		if( !InstrIsSet(cmd.itype, chg[i]) )
+			continue;
+
+		*ea = get_op_address(regs, x);
+		*size = (asize_t)get_dtyp_size(x.dtyp);
+		if( (cmd.itype == NN_stos || cmd.itype == NN_movs)
+			&& (cmd.auxpref & (aux_rep|aux_repne)) )
+		{
+			*size = ( regs[REG_ECX] < MAX_WRITE / *size ) ? *size * regs[REG_ECX] : MAX_WRITE;
+		}
+		return *size != 0;
+	}
+	return false;
+}
+//-------------------------------------------------------------
+
+
+//entropy of a page in bits per byte, -1 if unreadable
+static double page_entropy(ea_t page)
+{
+	uchar buf[PAGE_SIZE];
+	int counts[256];
+	double e = 0;
+	int i;
+
+	if( !get_many_bytes(page, buf, sizeof(buf)) )
+		return -1;
+
+	memset(counts, 0, sizeof(counts));
+	for( i=0; i<PAGE_SIZE; i++ )
+		counts[buf[i]]++;
+
+	for( i=0; i<256; i++ )
+	{
+		if( counts[i] != 0 )
+		{
+			double p = counts[i] / (double)PAGE_SIZE;
+			e -= p * log(p);
+		}
+	}
+	return e / log(2.0);
+}
+//-------------------------------------------------------------
+
+
+//only segments of the input file qualify as oep
+static segment_t *image_seg(ea_t ea)
+{
+	segment_t *s = getseg(ea);
+	if( s == NULL || s->is_debugger_segm() )
+		return NULL;
+	return s;
+}
+//-------------------------------------------------------------
+
+
+void oep_start(const ea_t *regs, int thr)
+{
+	segment_t *s;
+	int i;
+
+	if( !written_pages.clear() )
+		msg("-> EPF: not enough memory for the page bitmap, \"written\" is disabled.\n");
+	candidates.clear();
+	ranked.clear();
+	packed_pages.clear();
+	pushad_esp.clear();
+
+	threshold = thr > 0 ? thr : OEP_DEFAULT_THRESHOLD;
+	steps = 0;
+	prev_eip = prev_next = BADADDR;
+	s = getseg(regs[REG_EIP]);
+	entry_seg = s != NULL ? s->startEA : BADADDR;
+	entry_esp = regs[REG_ESP];
+	stack_dipped = false;
+	popad_armed = stack_armed = 0;
+	pending_size = 0;
+
+	//remember the pages that look packed right now
+	for( i=0; i<get_segm_qty(); i++ )
+	{
+		s = getnseg(i);
+		if( s->is_debugger_segm() )
+			continue;
+		for( ea_t page=PAGE(s->startEA); page < s->endEA; page += PAGE_SIZE )
+		{
+			if( page_entropy(page) >= ENTROPY_PACKED )
+				packed_pages[page] = false;
+		}
+	}
+
+	msg("-> EPF: scoring with threshold %d, %u packed pages.\n",
+		threshold, (ulong)packed_pages.size());
+}
+//-------------------------------------------------------------
+
+
+static int score_of(int detectors)
+{
+	int score = 0;
+	for( int i=0; i<OEP_DETECTORS; i++ )
+	{
+		if( detectors & (1 << i) )
+			score += weights[i];
+	}
+	return score;
+}
+
+static void detectors_str(int detectors, char *buf, size_t bufsize)
+{
+	buf[0] = '\0';
+	for( int i=0; i<OEP_DETECTORS; i++ )
+	{
+		if( detectors & (1 << i) )
+		{
+			if( buf[0] != '\0' )
+				qstrncat(buf, ",", bufsize);
+			qstrncat(buf, detector_names[i], bufsize);
+		}
+	}
+}
+
+//returns the candidate if it just crossed the threshold
+static ea_t add_score(ea_t ea, int fired)
+{
+	std::map<ea_t, candidate_t>::iterator p = candidates.find(ea);
+	char buf[MAXSTR];
+
+	if( p == candidates.end() )
+	{
+		candidate_t c;
+		c.ea = ea;
+		c.score = 0;
+		c.detectors = 0;
+		c.step = steps;
+		c.hits = 0;
+		c.reported = false;
+		p = candidates.insert(std::make_pair(ea, c)).first;
+	}
+
+	candidate_t &c = p->second;
+	c.hits++;
+	c.detectors |= fired;
+	c.score = score_of(c.detectors);
+	if( c.score < threshold || c.reported )
+		return BADADDR;
+
+	c.reported = true;
+	detectors_str(c.detectors, buf, sizeof(buf));
+	msg("-> EPF: OEP candidate %08X, score %d (%s) after %u steps.\n",
+		ea, c.score, buf, steps);
+	return ea;
+}
+//-------------------------------------------------------------
+
+
+//called for every traced step, regs holds the state
+//before the instruction at regs[REG_EIP] executes
+ea_t oep_step(const ea_t *regs)
+{
+	ea_t eip = regs[REG_EIP];
+	ea_t esp = regs[REG_ESP];
+	int fired = 0;
+	int size;
+
+	steps++;
+
+	//the previous instruction has executed by now
+	if( pending_size != 0 )
+	{
+		written_pages.set_range(pending_write, pending_size);
+		pending_size = 0;
+	}
+
+	if( prev_eip != BADADDR && eip != prev_next
+		&& PAGE(eip) != PAGE(prev_eip) )
+	{
+		segment_t *s = image_seg(eip);
+		if( s != NULL )
+		{
+			if( s->startEA != entry_seg && !s->contains(prev_eip) )
+				fired |= OEP_SECTION_HOP;
+			if( popad_armed )
+				fired |= OEP_PUSHAD_POPAD;
+			if( stack_armed )
+				fired |= OEP_STACK_RESTORE;
+			if( written_pages.test(eip) )
+				fired |= OEP_WRITTEN_JUMP;
+
+			std::map<ea_t, bool>::iterator p = packed_pages.find(PAGE(eip));
+			if( p != packed_pages.end() && !p->second )
+			{
+				//still packed: look again on the next transfer
+				double e = page_entropy(PAGE(eip));
+				if( e >= 0 && e < ENTROPY_DECODED )
+				{
+					p->second = true;
+					fired |= OEP_DECODED;
+				}
+			}
+		}
+	}
+
+	if( popad_armed ) popad_armed--;
+	if( stack_armed ) stack_armed--;
+
+	//stack back at its entry value?
+	if( esp < entry_esp )
+		stack_dipped = true;
+	else if( esp == entry_esp && stack_dipped )
+	{
+		stack_dipped = false;
+		stack_armed = ARMED_STEPS;
+	}
+
+	//look at the instruction that is about to execute
+	size = ua_ana0(eip);
+	prev_eip = eip;
+	prev_next = size != 0 ? eip + size : BADADDR;
+	if( size != 0 )
+	{
+		switch( cmd.itype )
+		{
+		case NN_pusha:
+		case NN_pushad:
+			if( pushad_esp.size() < 64 )
+				pushad_esp.push_back(esp);
+			break;
+		case NN_popa:
+		case NN_popad:
+			if( !pushad_esp.empty() && esp == pushad_esp.back() - 32 )
+			{
+				pushad_esp.pop_back();
+				popad_armed = ARMED_STEPS;
+			}
+			break;
+		}
+		if( get_insn_write(regs, &pending_write, &pending_size) )
+		{
+			if( pending_write + pending_size < pending_write )
+				pending_size = 0 - pending_write;
+		}
+	}
+
+	if( fired == 0 )
+		return BADADDR;
+	return add_score(eip, fired);
+}
+//-------------------------------------------------------------
+
+
+static bool rank_cmp(const candidate_t &a, const candidate_t &b)
+{
+	if( a.score != b.score )
+		return a.score > b.score;
+	return a.step < b.step;
+}
+
+static void build_ranking(void)
+{
+	ranked.clear();
+	for( std::map<ea_t, candidate_t>::iterator p=candidates.begin(); p != candidates.end(); ++p )
+		ranked.push_back(p->second);
+	std::sort(ranked.begin(), ranked.end(), rank_cmp);
+}
+//-------------------------------------------------------------
+
+
+//callback function for choose2() -> number of lines
+static ulong idaapi get_item_qty(void * /*obj*/)
+{
+	return (ulong)ranked.size();
+}
+
+//callback function for choose2() -> returns the n-th line
+static void idaapi getn_item_text(void * /*obj*/, ulong n, char * const *buf)
+{
+	if( n == 0 )
+	{
+		for( int i=0; i<5; i++ )
+			qstrncpy(buf[i], header[i], MAXSTR);
+		return;
+	}
+
+	const candidate_t &c = ranked[n-1];
+	char *segname = get_segm_name(c.ea);
+	qsnprintf(buf[0], MAXSTR, "%08X", c.ea);
+	qsnprintf(buf[1], MAXSTR, "%d", c.score);
+	detectors_str(c.detectors, buf[2], MAXSTR);
+	qstrncpy(buf[3], segname != NULL ? segname : "?", MAXSTR);
+	qsnprintf(buf[4], MAXSTR, "%u", c.step);
+}
+
+static ulong idaapi update_list(void * /*obj*/, ulong n)
+{
+	build_ranking();
+	return n;
+}
+
+static void idaapi jump_to_item(void * /*obj*/, ulong n)
+{
+	if( n > 0 && n <= ranked.size() )
+		jumpto(ranked[n-1].ea);
+}
+//-------------------------------------------------------------
+
+
+void oep_stop(void)
+{
+	msg("-> EPF: %u OEP candidates, see \"%s\".\n",
+		(ulong)candidates.size(), title);
+	if( !candidates.empty() )
+		oep_show_candidates();
+}
+
+void oep_show_candidates(void)
+{
+	build_ranking();
+	if( refresh_chooser(title) )
+		return;
+
+	choose2(
+		0,						// non-modal
+		-1,-1,-1,-1,			// autoposition
+		NULL,					// the list lives in 'ranked'
+		5,						// number of columns
+		widths,
+		get_item_qty,
+		getn_item_text,
+		title,
+		-1,						// no icon
+		1,						// starting item
+		NULL,					// "Delete"
+		NULL,					// "New"
+		update_list,			// "Update"
+		NULL,					// "Edit"
+		jump_to_item,			// "Enter"
+		NULL,					// "Destroy"
+		NULL);					// default popup names
+}
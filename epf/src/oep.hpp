@@ -0,0 +1,35 @@
+//////////////////////////////////////////////////
+//
+//  oep.hpp - EPF OEP scoring engine
+//
+//  -------------------------------------------
+//
+//	Runs all OEP heuristics side by side during
+//	a single trace. Every detector that fires
+//	at a control transfer adds its weight to
+//	the score of the transfer's target.
+//
+//////////////////////////////////////////////////
+
+#ifndef __OEP_HPP
+#define __OEP_HPP
+
+//detectors
+#define OEP_SECTION_HOP		0x0001	//eip reaches another section of the image
+#define OEP_PUSHAD_POPAD	0x0002	//transfer right after a matching popad
+#define OEP_STACK_RESTORE	0x0004	//transfer right after esp is back at its entry value
+#define OEP_WRITTEN_JUMP	0x0008	//eip reaches memory written during the trace
+#define OEP_DECODED			0x0010	//eip reaches memory that was packed at trace start
+#define OEP_DETECTORS		5
+
+#define OEP_DEFAULT_THRESHOLD	60
+
+void oep_start(const ea_t *regs, int threshold);
+ea_t oep_step(const ea_t *regs);
+void oep_stop(void);
+void oep_show_candidates(void);
+
+//memory written by the instruction in 'cmd' (decoded at regs[REG_EIP])
+bool get_insn_write(const ea_t *regs, ea_t *ea, asize_t *size);
+
+#endif // __OEP_HPP
@@ -0,0 +1,73 @@
+//////////////////////////////////////////////////
+//
+//  pagemap.hpp - EPF page bitmap
+//
+//  -------------------------------------------
+//
+//	One bit per 4k page of the 32 bit address
+//	space (128kb). Setting and testing a page
+//	is a shift and a mask, no matter how many
+//	pages have been marked.
+//
+//////////////////////////////////////////////////
+
+#ifndef __PAGEMAP_HPP
+#define __PAGEMAP_HPP
+
+#define PAGEMAP_PAGES	(1 << (32 - PAGE_SHIFT))
+#define PAGEMAP_WORDS	(PAGEMAP_PAGES / 32)
+
+class pagemap_t
+{
+	uint32 *bits;
+	ulong qty;
+
+	static ulong index(ea_t ea) { return (ulong)(ea >> PAGE_SHIFT) & (PAGEMAP_PAGES-1); }
+
+public:
+	pagemap_t(void) : bits(NULL), qty(0) {}
+	~pagemap_t(void) { qfree(bits); }
+
+	//allocates the bitmap on first use, false if out of memory
+	bool clear(void)
+	{
+		if( bits == NULL )
+			bits = (uint32 *)qalloc(PAGEMAP_WORDS * sizeof(uint32));
+		if( bits == NULL )
+			return false;
+		memset(bits, 0, PAGEMAP_WORDS * sizeof(uint32));
+		qty = 0;
+		return true;
+	}
+
+	bool test(ea_t ea) const
+	{
+		ulong i = index(ea);
+		return bits != NULL && (bits[i >> 5] & (1u << (i & 31))) != 0;
+	}
+
+	//returns true if the page was not marked before
+	bool set(ea_t ea)
+	{
+		ulong i = index(ea);
+		uint32 mask = 1u << (i & 31);
+		if( bits == NULL || (bits[i >> 5] & mask) != 0 )
+			return false;
+		bits[i >> 5] |= mask;
+		qty++;
+		return true;
+	}
+
+	//marks all pages touched by [ea, ea+size)
+	void set_range(ea_t ea, asize_t size)
+	{
+		ea_t page = ea & ~(PAGE_SIZE-1);
+		ulong n = (ulong)((ea - page + size + PAGE_SIZE-1) >> PAGE_SHIFT);
+		for( ; n != 0; n--, page += PAGE_SIZE )
+			set(page);
+	}
+
+	ulong count(void) const { return qty; }
+};
+
+#endif // __PAGEMAP_HPP
@@ -0,0 +1,239 @@
+//////////////////////////////////////////////////
+//
+//  recorder.cpp - EPF trace recorder
+//
+//  -------------------------------------------
+//
+//	The tracer encodes records directly into
+//	the current slot of a ring buffer. Once a
+//	block is full, the slot is handed over to
+//	the writer thread which flushes it to disk.
+//	The tracer only waits if all slots are
+//	still waiting to be written.
+//
+//	The writer thread must not call any IDA
+//	function, all messages are printed from the
+//	tracer's side.
+//
+//////////////////////////////////////////////////
+
+#include <windows.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+
+#include "recorder.hpp"
+
+#define RING_SLOTS		16
+#define SLOT_SIZE		(EPT_BLK_HDR_SIZE + EPT_BLK_PAYLOAD)
+
+
+//ring buffer shared with the writer thread
+static ept_u8 *ring = NULL;
+static ept_u32 slot_size[RING_SLOTS];
+static volatile LONG head = 0;		//number of sealed blocks
+static volatile LONG tail = 0;		//number of written blocks
+static volatile LONG stopping = 0;
+static volatile LONG write_error = 0;
+
+static HANDLE h_writer = NULL;
+static HANDLE h_data = NULL;		//signaled when a block was sealed
+static HANDLE h_space = NULL;		//signaled when a block was written
+
+static FILE *file = NULL;
+static ept_encoder_t enc;
+static ept_u64 steps = 0;
+static ept_u64 bytes = 0;
+static ept_u32 stalls = 0;
+static bool active = false;
+static bool with_regs = false;
+//-------------------------------------------------------------
+
+
+static DWORD WINAPI writer_thread(void * /*param*/)
+{
+	for(;;)
+	{
+		//rec_stop() seals the last block before it sets 'stopping',
+		//so once it is seen here, one more drain gets everything
+		LONG stop = stopping;
+
+		while( tail != head )
+		{
+			int n = tail % RING_SLOTS;
+			if( !write_error &&
+				qfwrite(file, ring + n*SLOT_SIZE, slot_size[n]) != (ssize_t)slot_size[n] )
+			{
+				InterlockedExchange(&write_error, 1);
+			}
+			InterlockedIncrement(&tail);
+			SetEvent(h_space);
+		}
+		if( stop )
+			break;
+		WaitForSingleObject(h_data, INFINITE);
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+//hands the current block over to the writer thread
+//and starts a new one in the next free slot
+static void seal_block(void)
+{
+	int n = head % RING_SLOTS;
+
+	ept_write_block_header(ring + n*SLOT_SIZE, enc.blk);
+	slot_size[n] = EPT_BLK_HDR_SIZE + enc.blk.payload_size;
+	bytes += slot_size[n];
+	InterlockedIncrement(&head);
+	SetEvent(h_data);
+
+	//all slots in use, wait for the writer
+	if( head - tail == RING_SLOTS )
+	{
+		stalls++;
+		while( head - tail == RING_SLOTS )
+			WaitForSingleObject(h_space, INFINITE);
+	}
+
+	n = head % RING_SLOTS;
+	enc.start(ring + n*SLOT_SIZE + EPT_BLK_HDR_SIZE, steps, with_regs);
+}
+//-------------------------------------------------------------
+
+
+bool rec_start(const char *filename, bool regs)
+{
+	ept_header_t hdr;
+	ept_u8 buf[EPT_HDR_SIZE];
+	DWORD tid;
+
+	if( active )
+		rec_stop();
+
+	file = qfopen(filename, "wb");
+	if( file == NULL )
+	{
+		msg("-> EPF: could not create trace file %s\n", filename);
+		return false;
+	}
+
+	hdr.version = EPT_VERSION;
+	hdr.flags = regs ? EPT_FLAG_REGS : 0;
+	hdr.nregs = EPT_NREGS;
+	hdr.blk_records = EPT_BLK_RECORDS;
+	ept_write_header(buf, hdr);
+	qfwrite(file, buf, sizeof(buf));
+
+	ring = (ept_u8 *)malloc(RING_SLOTS * SLOT_SIZE);
+	if( ring == NULL )
+	{
+		qfclose(file);
+		file = NULL;
+		msg("-> EPF: not enough memory for the trace buffer\n");
+		return false;
+	}
+
+	head = tail = 0;
+	stopping = write_error = 0;
+	steps = bytes = 0;
+	stalls = 0;
+	with_regs = regs;
+	enc = ept_encoder_t();
+	enc.start(ring + EPT_BLK_HDR_SIZE, 0, with_regs);
+
+	h_data = CreateEvent(NULL, FALSE, FALSE, NULL);
+	h_space = CreateEvent(NULL, FALSE, FALSE, NULL);
+	if( h_data != NULL && h_space != NULL )
+		h_writer = CreateThread(NULL, 0, writer_thread, NULL, 0, &tid);
+	if( h_writer == NULL )
+	{
+		if( h_data != NULL )
+			CloseHandle(h_data);
+		if( h_space != NULL )
+			CloseHandle(h_space);
+		h_data = h_space = NULL;
+		free(ring);
+		ring = NULL;
+		qfclose(file);
+		file = NULL;
+		msg("-> EPF: could not start the trace writer\n");
+		return false;
+	}
+
+	active = true;
+	msg("-> EPF: recording trace to %s\n", filename);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+void rec_add(const ept_state_t &s)
+{
+	if( !active )
+		return;
+
+	enc.add(s);
+	steps++;
+	if( enc.full() )
+	{
+		seal_block();
+		if( write_error )
+		{
+			msg("-> EPF: error writing the trace file, recording stopped.\n");
+			rec_stop();
+		}
+	}
+}
+//-------------------------------------------------------------
+
+
+void rec_stop(void)
+{
+	if( !active )
+		return;
+	active = false;
+
+	if( !enc.empty() )
+	{
+		int n = head % RING_SLOTS;
+		ept_write_block_header(ring + n*SLOT_SIZE, enc.blk);
+		slot_size[n] = EPT_BLK_HDR_SIZE + enc.blk.payload_size;
+		bytes += slot_size[n];
+		InterlockedIncrement(&head);
+	}
+
+	//let the writer drain the ring and wait for it
+	InterlockedExchange(&stopping, 1);
+	SetEvent(h_data);
+	WaitForSingleObject(h_writer, INFINITE);
+
+	CloseHandle(h_writer);
+	CloseHandle(h_data);
+	CloseHandle(h_space);
+	h_writer = h_data = h_space = NULL;
+
+	qfclose(file);
+	file = NULL;
+	free(ring);
+	ring = NULL;
+
+	msg("-> EPF: trace recorded, %u steps in %u bytes (%u stalls)%s\n",
+		(ulong)steps, (ulong)(bytes + EPT_HDR_SIZE), stalls,
+		write_error ? ", WRITE ERROR" : "");
+}
+//-------------------------------------------------------------
+
+
+bool rec_active(void)
+{
+	return active;
+}
+
+bool rec_regs(void)
+{
+	return active && with_regs;
+}
@@ -0,0 +1,25 @@
+//////////////////////////////////////////////////
+//
+//  recorder.hpp - EPF trace recorder
+//
+//  -------------------------------------------
+//
+//	Records every traced step into a trace file
+//	(see eptrace.hpp). Blocks are encoded on the
+//	tracer's thread straight into a ring buffer
+//	and written to disk by a background thread.
+//
+//////////////////////////////////////////////////
+
+#ifndef __RECORDER_HPP
+#define __RECORDER_HPP
+
+#include "eptrace.hpp"
+
+bool rec_start(const char *filename, bool regs);
+void rec_add(const ept_state_t &s);
+void rec_stop(void);
+bool rec_active(void);
+bool rec_regs(void);
+
+#endif // __RECORDER_HPP
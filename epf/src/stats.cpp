@@ -0,0 +1,178 @@
+//////////////////////////////////////////////////
+//
+//  stats.cpp - EPF tracer instrumentation
+//
+//  -------------------------------------------
+//
+//	Timestamps come from the performance
+//	counter, which costs well below a micro-
+//	second - negligible compared to a single
+//	debug event. Samples are only converted to
+//	nanoseconds for the histogram bucket.
+//
+//////////////////////////////////////////////////
+
+#include <windows.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+
+#include "stats.hpp"
+
+//samples longer than this are clipped (the process
+//may have been suspended between two events)
+#define MAX_SAMPLE_SEC	60
+
+struct stat_t
+{
+	uint64 count;
+	uint64 total;			//ticks
+	uint64 max;				//ticks
+	uint64 hist[ST_BUCKETS];
+};
+
+static const char *names[ST_QTY] =
+{
+	"debugger", "callback", "get_reg", "cond", "record", "ui"
+};
+
+static stat_t stats[ST_QTY];
+static uint64 freq = 0;
+static uint64 ns_mul;		//ns per tick, 20 bit fixed point
+static uint64 start = 0;
+static uint64 last_event_end = 0;
+static uint64 event_begin = 0;
+//-------------------------------------------------------------
+
+
+void stats_reset(void)
+{
+	LARGE_INTEGER li;
+
+	if( freq == 0 )
+	{
+		QueryPerformanceFrequency(&li);
+		freq = li.QuadPart;
+		ns_mul = (uint64)(1000000000.0 * (1 << 20) / freq);
+	}
+	memset(stats, 0, sizeof(stats));
+	start = stats_now();
+	last_event_end = 0;
+}
+//-------------------------------------------------------------
+
+
+uint64 stats_now(void)
+{
+	LARGE_INTEGER li;
+	QueryPerformanceCounter(&li);
+	return li.QuadPart;
+}
+//-------------------------------------------------------------
+
+
+void stats_add(int what, uint64 ticks)
+{
+	stat_t &s = stats[what];
+	uint64 ns;
+	int b;
+
+	if( ticks > freq * MAX_SAMPLE_SEC )
+		ticks = freq * MAX_SAMPLE_SEC;
+
+	s.count++;
+	s.total += ticks;
+	if( ticks > s.max )
+		s.max = ticks;
+
+	//bucket 0: < 256ns, bucket n: < 256ns << n
+	ns = (ticks * ns_mul) >> 28;
+	for( b=0; ns != 0 && b < ST_BUCKETS-1; b++ )
+		ns >>= 1;
+	s.hist[b]++;
+}
+//-------------------------------------------------------------
+
+
+//brackets dbg_callback(), the time between two
+//events is what the debugger (and ida) spent
+void stats_event_begin(void)
+{
+	event_begin = stats_now();
+	if( last_event_end != 0 )
+		stats_add(ST_DEBUGGER, event_begin - last_event_end);
+}
+
+void stats_event_end(void)
+{
+	last_event_end = stats_now();
+	stats_add(ST_CALLBACK, last_event_end - event_begin);
+}
+//-------------------------------------------------------------
+
+
+static double to_ms(uint64 ticks)
+{
+	return freq != 0 ? ticks * 1000.0 / freq : 0;
+}
+
+static void bucket_name(int b, char *buf, size_t bufsize)
+{
+	double limit = 256.0 * (1 << b);
+
+	if( b == ST_BUCKETS-1 )
+		qsnprintf(buf, bufsize, ">= %.0fus", limit / 2 / 1000);
+	else if( limit < 1000 )
+		qsnprintf(buf, bufsize, "< %.0fns", limit);
+	else if( limit < 1000000 )
+		qsnprintf(buf, bufsize, "< %.1fus", limit / 1000);
+	else
+		qsnprintf(buf, bufsize, "< %.1fms", limit / 1000000);
+}
+
+void stats_dump(void)
+{
+	char buf[MAXSTR];
+	double secs;
+	int i, b;
+
+	if( freq == 0 )
+	{
+		msg("-> EPF: no statistics yet.\n");
+		return;
+	}
+
+	secs = to_ms(stats_now() - start) / 1000;
+	msg("-> EPF: tracer statistics, %u events in %.1f sec (%.0f events/sec)\n",
+		(ulong)stats[ST_CALLBACK].count, secs,
+		secs > 0 ? stats[ST_CALLBACK].count / secs : 0.0);
+
+	msg("   %-10s %10s %12s %10s %10s\n", "", "count", "total ms", "avg us", "max us");
+	for( i=0; i<ST_QTY; i++ )
+	{
+		const stat_t &s = stats[i];
+		msg("   %-10s %10u %12.1f %10.2f %10.1f\n",
+			names[i], (ulong)s.count, to_ms(s.total),
+			s.count ? to_ms(s.total) * 1000 / s.count : 0.0,
+			to_ms(s.max) * 1000);
+	}
+
+	msg("\n   %-10s", "latency");
+	for( i=0; i<ST_QTY; i++ )
+		msg(" %9s", names[i]);
+	msg("\n");
+	for( b=0; b<ST_BUCKETS; b++ )
+	{
+		bool used = false;
+		for( i=0; i<ST_QTY; i++ )
+			used |= stats[i].hist[b] != 0;
+		if( !used )
+			continue;
+		bucket_name(b, buf, sizeof(buf));
+		msg("   %-10s", buf);
+		for( i=0; i<ST_QTY; i++ )
+			msg(" %9u", (ulong)stats[i].hist[b]);
+		msg("\n");
+	}
+}
@@ -0,0 +1,39 @@
+//////////////////////////////////////////////////
+//
+//  stats.hpp - EPF tracer instrumentation
+//
+//  -------------------------------------------
+//
+//	Counts and times the parts of a trace step
+//	so a slow run can be attributed to the
+//	debugger, the conditions or the ui. Every
+//	sample goes into a fixed-bucket histogram
+//	(powers of two, starting at 256ns).
+//
+//////////////////////////////////////////////////
+
+#ifndef __STATS_HPP
+#define __STATS_HPP
+
+//what is being timed
+enum
+{
+	ST_DEBUGGER,	//from the end of one debug event to the next one
+	ST_CALLBACK,	//dbg_callback() as a whole
+	ST_GETREG,		//single get_reg_val() calls
+	ST_COND,		//evaluation of the stop condition
+	ST_RECORD,		//trace recording
+	ST_UI,			//showAddr(), jumpto() and messages
+	ST_QTY
+};
+
+#define ST_BUCKETS	18
+
+void stats_reset(void);
+uint64 stats_now(void);
+void stats_add(int what, uint64 ticks);
+void stats_event_end(void);
+void stats_event_begin(void);
+void stats_dump(void);
+
+#endif // __STATS_HPP
@@ -0,0 +1,205 @@
+//////////////////////////////////////////////////
+//
+//  wwatch.cpp - EPF memory-write watch
+//
+//  -------------------------------------------
+//
+//	Written pages are collected in a page
+//	bitmap from two sources:
+//
+//	- traced writes: the memory operand of
+//	  every traced instruction (see
+//	  get_insn_write() in oep.cpp)
+//	- page hashes: writes the tracer cannot
+//	  see (stepped-over calls, other threads,
+//	  the kernel) are found by hashing the
+//	  pages of the image. This happens every
+//	  RESCAN_INTERVAL steps and after a
+//	  stepped-over call or int returned, but
+//	  not more often than every RESCAN_MIN
+//	  steps.
+//
+//	The bitmap is only tested when EIP enters
+//	a new page, so the per-step cost does not
+//	depend on the number of written pages.
+//
+//////////////////////////////////////////////////
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <bytes.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <intel.hpp>
+
+#include <vector>
+
+#include "epf.hpp"
+#include "oep.hpp"
+#include "pagemap.hpp"
+#include "wwatch.hpp"
+
+#define RESCAN_INTERVAL	8192	//steps
+#define RESCAN_MIN		256		//steps
+
+#define PAGE(ea)		((ea) & ~(PAGE_SIZE-1))
+
+struct page_hash_t
+{
+	ea_t page;
+	uint32 hash;
+	bool readable;
+};
+
+static pagemap_t written;
+static std::vector<page_hash_t> hashes;
+static pagemap_t hashed;			//written pages found by a rescan
+
+static ulong steps;
+static ulong last_scan;
+static ulong scans;
+static ea_t prev_eip;
+static ea_t prev_next;
+static bool prev_stepover;
+static ea_t pending_write;
+static asize_t pending_size;
+//-------------------------------------------------------------
+
+
+//FNV-1a on 32 bit words
+static uint32 page_hash(const uchar *data)
+{
+	const uint32 *p = (const uint32 *)data;
+	uint32 h = 2166136261u;
+	for( int i=0; i<PAGE_SIZE/4; i++ )
+		h = (h ^ p[i]) * 16777619u;
+	return h;
+}
+//-------------------------------------------------------------
+
+
+//hashes all pages of the image. If 'compare' is set,
+//pages whose hash changed are marked as written
+static void scan_pages(bool compare)
+{
+	uchar buf[PAGE_SIZE];
+	size_t n = 0;
+
+	for( int i=0; i<get_segm_qty(); i++ )
+	{
+		segment_t *s = getnseg(i);
+		if( s->is_debugger_segm() )
+			continue;
+
+		invalidate_dbgmem_contents(s->startEA, s->endEA - s->startEA);
+		for( ea_t page=PAGE(s->startEA); page < s->endEA; page += PAGE_SIZE, n++ )
+		{
+			page_hash_t h;
+			h.page = page;
+			h.readable = get_many_bytes(page, buf, PAGE_SIZE);
+			h.hash = h.readable ? page_hash(buf) : 0;
+
+			if( !compare )
+				hashes.push_back(h);
+			else if( n < hashes.size() && hashes[n].page == page )
+			{
+				if( h.readable != hashes[n].readable || h.hash != hashes[n].hash )
+				{
+					if( written.set(page) )
+						hashed.set(page);
+					hashes[n] = h;
+				}
+			}
+		}
+	}
+	last_scan = steps;
+	scans++;
+}
+//-------------------------------------------------------------
+
+
+bool ww_start(const ea_t *regs)
+{
+	if( !written.clear() || !hashed.clear() )
+	{
+		msg("-> EPF: not enough memory for the page bitmap.\n");
+		return false;
+	}
+	hashes.clear();
+	steps = scans = 0;
+	prev_eip = prev_next = BADADDR;
+	prev_stepover = false;
+	pending_size = 0;
+
+	scan_pages(false);
+	msg("-> EPF: watching %u pages of the image for writes, starting at %08X.\n",
+		(ulong)hashes.size(), regs[REG_EIP]);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+//called for every traced step, returns true if
+//eip just entered a page that was written before
+bool ww_step(const ea_t *regs)
+{
+	ea_t eip = regs[REG_EIP];
+	bool hit = false;
+	int size;
+
+	steps++;
+
+	//the previous instruction has executed by now
+	if( pending_size != 0 )
+	{
+		written.set_range(pending_write, pending_size);
+		pending_size = 0;
+	}
+
+	if( steps - last_scan >= RESCAN_INTERVAL
+		|| (prev_stepover && eip == prev_next && steps - last_scan >= RESCAN_MIN) )
+		scan_pages(true);
+
+	if( PAGE(eip) != PAGE(prev_eip) && written.test(eip) )
+	{
+		msg("-> EPF: EIP entered written page %08X at %08X after %u steps (%s).\n",
+			PAGE(eip), eip, steps, hashed.test(eip) ? "found by page hash" : "traced write");
+		hit = true;
+	}
+
+	//see what the instruction about to execute will write
+	size = ua_ana0(eip);
+	prev_eip = eip;
+	prev_next = size != 0 ? eip + size : BADADDR;
+	prev_stepover = false;
+	if( size != 0 )
+	{
+		switch( cmd.itype )
+		{
+		case NN_call:
+		case NN_callfi:
+		case NN_callni:
+		case NN_int:
+		case NN_into:
+		case NN_sysenter:
+		case NN_syscall:
+			prev_stepover = true;
+			break;
+		}
+		if( get_insn_write(regs, &pending_write, &pending_size) )
+		{
+			if( pending_write + pending_size < pending_write )
+				pending_size = 0 - pending_write;
+		}
+	}
+	return hit;
+}
+//-------------------------------------------------------------
+
+
+void ww_stop(void)
+{
+	msg("-> EPF: %u written pages (%u found by page hash), %u rescans in %u steps.\n",
+		written.count(), hashed.count(), scans, steps);
+	hashes.clear();
+}
@@ -0,0 +1,21 @@
+//////////////////////////////////////////////////
+//
+//  wwatch.hpp - EPF memory-write watch
+//
+//  -------------------------------------------
+//
+//	Keeps track of the pages written during
+//	the trace and reports when EIP enters one
+//	of them ("execution reaches memory that was
+//	written earlier").
+//
+//////////////////////////////////////////////////
+
+#ifndef __WWATCH_HPP
+#define __WWATCH_HPP
+
+bool ww_start(const ea_t *regs);
+bool ww_step(const ea_t *regs);
+void ww_stop(void);
+
+#endif // __WWATCH_HPP
@@ -0,0 +1,332 @@
+//////////////////////////////////////////////////
+//
+//  eptq - EPF trace query tool
+//  written for the EPF plugin.
+//
+//  -------------------------------------------
+//
+//	Answers questions about trace files that
+//	were recorded by EPF ("Record trace").
+//	The file is read block by block, so traces
+//	of any size can be queried. Blocks whose
+//	summary cannot match the query are skipped
+//	without being decoded.
+//
+//	Build (Linux):
+//	  g++ -O2 -o eptq eptq.cpp
+//
+//	Usage:
+//	  eptq info   <file>
+//	  eptq dump   <file> [first_step [count]]
+//	  eptq first  <file> <lo> <hi>
+//	  eptq enter  <file> <lo> <hi> [max]
+//	  eptq writes <file> <reg> [max]
+//
+//	'first' prints the first step at which EIP
+//	entered the range [lo, hi] (inclusive),
+//	'enter' prints all of them. 'writes' lists
+//	every step that changed the given register
+//	(needs a trace recorded with registers).
+//
+//	-------------------------------------------
+//
+//	history:
+//	--------
+//	-	19.10.2026:
+//		initial version
+//
+//////////////////////////////////////////////////
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "../src/eptrace.hpp"
+
+typedef unsigned long long u64;
+
+
+static FILE *f = NULL;
+static ept_header_t hdr;
+static ept_u8 payload[EPT_BLK_PAYLOAD];
+//-------------------------------------------------------------
+
+
+static bool open_trace(const char *name)
+{
+	ept_u8 buf[EPT_HDR_SIZE];
+
+	f = fopen(name, "rb");
+	if( f == NULL )
+	{
+		fprintf(stderr, "eptq: cannot open %s\n", name);
+		return false;
+	}
+	if( fread(buf, 1, sizeof(buf), f) != sizeof(buf) || !ept_read_header(buf, &hdr) )
+	{
+		fprintf(stderr, "eptq: %s is not an EPF trace file\n", name);
+		return false;
+	}
+	return true;
+}
+//-------------------------------------------------------------
+
+
+//reads the next block header, returns false at the end of the file
+static bool next_block(ept_block_t *b)
+{
+	ept_u8 buf[EPT_BLK_HDR_SIZE];
+	size_t n = fread(buf, 1, sizeof(buf), f);
+
+	if( n == 0 )
+		return false;
+	if( n != sizeof(buf) || !ept_read_block_header(buf, b) )
+	{
+		fprintf(stderr, "eptq: corrupt block at offset %lld\n",
+			(long long)(ftello(f) - n));
+		return false;
+	}
+	return true;
+}
+
+static bool read_payload(const ept_block_t &b)
+{
+	if( fread(payload, 1, b.payload_size, f) != b.payload_size )
+	{
+		fprintf(stderr, "eptq: truncated block\n");
+		return false;
+	}
+	return true;
+}
+
+static void skip_payload(const ept_block_t &b)
+{
+	fseeko(f, b.payload_size, SEEK_CUR);
+}
+//-------------------------------------------------------------
+
+
+static bool has_regs(void)
+{
+	return (hdr.flags & EPT_FLAG_REGS) != 0;
+}
+
+static void print_state(u64 step, const ept_state_t &s)
+{
+	printf("%12llu  %08X", step, s.eip);
+	if( has_regs() )
+	{
+		for( int i=0; i < EPT_NREGS; i++ )
+			printf(" %s=%08X", ept_regnames[i], s.regs[i]);
+	}
+	printf("\n");
+}
+//-------------------------------------------------------------
+
+
+static int cmd_info(void)
+{
+	ept_block_t b;
+	u64 blocks = 0;
+	u64 steps = 0;
+	u64 bytes = EPT_HDR_SIZE;
+	ept_u32 lo = 0xFFFFFFFF, hi = 0;
+
+	while( next_block(&b) )
+	{
+		blocks++;
+		steps += b.count;
+		bytes += EPT_BLK_HDR_SIZE + b.payload_size;
+		if( b.eip_min < lo ) lo = b.eip_min;
+		if( b.eip_max > hi ) hi = b.eip_max;
+		skip_payload(b);
+	}
+
+	printf("version   : %u\n", hdr.version);
+	printf("registers : %s\n", has_regs() ? "yes" : "no");
+	printf("blocks    : %llu\n", blocks);
+	printf("steps     : %llu\n", steps);
+	printf("bytes     : %llu (%.2f per step)\n", bytes, steps ? (double)bytes/steps : 0.0);
+	if( steps != 0 )
+		printf("eip range : %08X - %08X\n", lo, hi);
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+static int cmd_dump(u64 first, u64 count)
+{
+	ept_block_t b;
+	ept_decoder_t d;
+	u64 last = first + count;
+
+	while( next_block(&b) )
+	{
+		if( b.first_step + b.count <= first )
+		{
+			skip_payload(b);
+			continue;
+		}
+		if( b.first_step >= last || !read_payload(b) )
+			break;
+		d.start(b, payload, has_regs());
+		while( d.next() )
+		{
+			if( d.step >= last )
+				return 0;
+			if( d.step >= first )
+				print_state(d.step, d.cur);
+		}
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+//lists the steps at which EIP moved into [lo, hi]
+static int cmd_enter(ept_u32 lo, ept_u32 hi, u64 max)
+{
+	ept_block_t b;
+	ept_decoder_t d;
+	bool inside = false;
+	u64 hits = 0;
+
+	while( next_block(&b) )
+	{
+		//no EIP of this block is inside the range
+		if( b.eip_max < lo || b.eip_min > hi )
+		{
+			inside = false;
+			skip_payload(b);
+			continue;
+		}
+		if( !read_payload(b) )
+			break;
+		d.start(b, payload, has_regs());
+		while( d.next() )
+		{
+			bool in = d.cur.eip >= lo && d.cur.eip <= hi;
+			if( in && !inside )
+			{
+				print_state(d.step, d.cur);
+				if( ++hits == max )
+					return 0;
+			}
+			inside = in;
+		}
+	}
+	if( hits == 0 )
+		printf("EIP never entered %08X - %08X\n", lo, hi);
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+static int cmd_writes(int reg, u64 max)
+{
+	ept_block_t b;
+	ept_decoder_t d;
+	u64 hits = 0;
+
+	if( !has_regs() )
+	{
+		fprintf(stderr, "eptq: trace was recorded without registers\n");
+		return 1;
+	}
+
+	while( next_block(&b) )
+	{
+		if( (b.regmask & (1 << reg)) == 0 )
+		{
+			skip_payload(b);
+			continue;
+		}
+		if( !read_payload(b) )
+			break;
+		d.start(b, payload, true);
+		ept_u32 old = d.cur.regs[reg];
+		ept_u32 prev_eip = d.cur.eip;
+		while( d.next() )
+		{
+			//the register was changed by the instruction at prev_eip
+			if( d.changed & (1 << reg) )
+			{
+				printf("%12llu  %08X  %s: %08X -> %08X\n",
+					d.step, prev_eip, ept_regnames[reg], old, d.cur.regs[reg]);
+				if( ++hits == max )
+					return 0;
+			}
+			old = d.cur.regs[reg];
+			prev_eip = d.cur.eip;
+		}
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"eptq - EPF trace query tool\n\n"
+		"usage:\n"
+		"  eptq info   <file>\n"
+		"  eptq dump   <file> [first_step [count]]\n"
+		"  eptq first  <file> <lo> <hi>\n"
+		"  eptq enter  <file> <lo> <hi> [max]\n"
+		"  eptq writes <file> <reg> [max]\n\n"
+		"addresses are hex unless prefixed, registers are eax..esp\n");
+}
+
+static ept_u32 parse_addr(const char *s)
+{
+	return (ept_u32)strtoul(s, NULL, (s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) ? 0 : 16);
+}
+
+int main(int argc, char *argv[])
+{
+	if( argc < 3 )
+	{
+		usage();
+		return 1;
+	}
+
+	const char *cmd = argv[1];
+	if( !open_trace(argv[2]) )
+		return 1;
+
+	if( strcmp(cmd, "info") == 0 )
+		return cmd_info();
+
+	if( strcmp(cmd, "dump") == 0 )
+	{
+		u64 first = argc > 3 ? strtoull(argv[3], NULL, 0) : 0;
+		u64 count = argc > 4 ? strtoull(argv[4], NULL, 0) : ~0ULL - first;
+		return cmd_dump(first, count);
+	}
+
+	if( (strcmp(cmd, "first") == 0 || strcmp(cmd, "enter") == 0) && argc > 4 )
+	{
+		u64 max = strcmp(cmd, "first") == 0 ? 1 : 0;
+		if( argc > 5 )
+			max = strtoull(argv[5], NULL, 0);
+		return cmd_enter(parse_addr(argv[3]), parse_addr(argv[4]), max);
+	}
+
+	if( strcmp(cmd, "writes") == 0 && argc > 3 )
+	{
+		for( int i=0; i < EPT_NREGS; i++ )
+		{
+			if( strcmp(argv[3], ept_regnames[i]) == 0 )
+				return cmd_writes(i, argc > 4 ? strtoull(argv[4], NULL, 0) : 0);
+		}
+		fprintf(stderr, "eptq: unknown register %s\n", argv[3]);
+		return 1;
+	}
+
+	usage();
+	return 1;
+}
@@ -0,0 +1,256 @@
+/*
+ *	laycache.cpp
+ *	------------
+ *	A layout is stored as an array of ints:
+ *
+ *	  hash, number of nodes, number of edges,
+ *	  nodes * (left, top, right, bottom),
+ *	  edges * (srcoff, dstoff, number of points, points * (x, y))
+ *
+ *	The edges are in the order of the successor lists.
+ *	The hash covers the layout type, the number, width and
+ *	height of the nodes and all edges, so a graph whose
+ *	nodes got new text or whose edges changed is laid out
+ *	again.
+ *
+ *	In the database every graph has a netnode of its own,
+ *	one blob per layout type:
+ *
+ *	  "$ graphtest layouts"  supval(graph id, 'N') = node
+ *	  node                   blob(0, 'A' + layout type)
+ *
+ *	(blobs take consecutive indexes, so they can't be put
+ *	into one netnode by graph id)
+ *
+ */
+
+#include <windows.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <graph.hpp>
+#include <kernwin.hpp>
+#include <netnode.hpp>
+
+#include <vector>
+
+#include "laycache.hpp"
+
+#define LC_NODE		"$ graphtest layouts"
+#define LC_SIZE		32		// layouts kept in memory
+
+struct lc_entry_t
+{
+	uval_t gid;
+	int layout;
+	unsigned int used;		// stamp of the last use, 0 = free
+	std::vector<int> data;
+};
+
+static lc_entry_t lru[LC_SIZE];
+static unsigned int stamp = 0;
+
+//--------------------------------------------------------------------------
+// FNV-1a of the layout type, the node sizes and the edges
+static unsigned int lc_hash(mutable_graph_t *g, int layout)
+{
+	unsigned int h = 2166136261u;
+	int n = g->size();
+
+#define MIX(v) { unsigned int _v = (unsigned int)(v); \
+		for ( int _j=0; _j<32; _j+=8 ) h = (h ^ ((_v >> _j) & 0xFF)) * 16777619u; }
+
+	MIX(layout);
+	MIX(n);
+	for ( int i=0; i<n; i++ )
+	{
+		MIX(g->nodes[i].width());
+		MIX(g->nodes[i].height());
+		MIX(g->nsucc(i));
+		for ( int k=0; k<g->nsucc(i); k++ )
+			MIX(g->succ(i, k));
+	}
+#undef MIX
+	return h;
+}
+
+//--------------------------------------------------------------------------
+static void lc_save(mutable_graph_t *g, unsigned int hash, std::vector<int> &data)
+{
+	int n = g->size();
+
+	data.clear();
+	data.push_back((int)hash);
+	data.push_back(n);
+	data.push_back(0);
+	for ( int i=0; i<n; i++ )
+	{
+		const rect_t &r = g->nodes[i];
+		data.push_back(r.left);
+		data.push_back(r.top);
+		data.push_back(r.right);
+		data.push_back(r.bottom);
+	}
+	for ( int i=0; i<n; i++ )
+	{
+		for ( int k=0; k<g->nsucc(i); k++ )
+		{
+			edge_info_t *ei = g->get_edge(edge_t(i, g->succ(i, k)));
+			data[2]++;
+			data.push_back(ei != NULL ? ei->srcoff : -1);
+			data.push_back(ei != NULL ? ei->dstoff : -1);
+			data.push_back(ei != NULL ? (int)ei->layout.size() : 0);
+			if ( ei == NULL )
+				continue;
+			for ( size_t p=0; p<ei->layout.size(); p++ )
+			{
+				data.push_back(ei->layout[p].x);
+				data.push_back(ei->layout[p].y);
+			}
+		}
+	}
+}
+
+// false if data doesn't belong to g
+static bool lc_apply(mutable_graph_t *g, unsigned int hash, const std::vector<int> &data)
+{
+	int n = g->size();
+
+	if ( data.size() < 3 || (unsigned int)data[0] != hash || data[1] != n
+	  || data.size() < 3 + (size_t)n * 4 )
+		return false;
+
+	const int *p = &data[3];
+	const int *end = &data[0] + data.size();
+	for ( int i=0; i<n; i++, p+=4 )
+		g->nodes[i] = rect_t(p[0], p[1], p[2], p[3]);
+	for ( int i=0; i<n; i++ )
+	{
+		for ( int k=0; k<g->nsucc(i); k++ )
+		{
+			if ( end - p < 3 || end - p < 3 + 2 * p[2] )
+				return false;
+			edge_info_t *ei = g->get_edge(edge_t(i, g->succ(i, k)));
+			if ( ei != NULL )
+			{
+				ei->srcoff = p[0];
+				ei->dstoff = p[1];
+				ei->layout.resize(p[2]);
+				for ( int q=0; q<p[2]; q++ )
+					ei->layout[q] = point_t(p[3 + q*2], p[4 + q*2]);
+			}
+			p += 3 + 2 * p[2];
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------
+// the netnode of graph gid, BADNODE if there is none
+static netnode lc_node(uval_t gid, bool create)
+{
+	netnode main;
+	nodeidx_t id;
+
+	if ( create )
+		main.create(LC_NODE);
+	else
+	{
+		main = netnode(LC_NODE);
+		if ( main == BADNODE )
+			return netnode(BADNODE);
+	}
+	if ( main.supval(gid, &id, sizeof(id), 'N') == sizeof(id) )
+		return netnode(id);
+	if ( !create )
+		return netnode(BADNODE);
+
+	netnode n;
+	n.create();
+	id = n;
+	main.supset(gid, &id, sizeof(id), 'N');
+	return n;
+}
+
+static lc_entry_t *lc_find(uval_t gid, int layout)
+{
+	for ( int i=0; i<LC_SIZE; i++ )
+	{
+		if ( lru[i].used != 0 && lru[i].gid == gid && lru[i].layout == layout )
+			return &lru[i];
+	}
+	return NULL;
+}
+
+// a free entry or the least recently used one
+static lc_entry_t *lc_slot(uval_t gid, int layout)
+{
+	lc_entry_t *e = lc_find(gid, layout);
+	if ( e != NULL )
+		return e;
+	e = &lru[0];
+	for ( int i=1; i<LC_SIZE && e->used != 0; i++ )
+	{
+		if ( lru[i].used < e->used )
+			e = &lru[i];
+	}
+	e->gid = gid;
+	e->layout = layout;
+	e->data.clear();
+	return e;
+}
+
+//--------------------------------------------------------------------------
+bool lc_restore(mutable_graph_t *g, int layout)
+{
+	unsigned int hash = lc_hash(g, layout);
+	lc_entry_t *e = lc_find(g->gid, layout);
+
+	if ( e == NULL )
+	{
+		netnode n = lc_node(g->gid, false);
+		size_t size;
+		if ( n == BADNODE )
+			return false;
+		size = n.blobsize(0, (char)('A' + layout));
+		if ( size < 3 * sizeof(int) )
+			return false;
+		e = lc_slot(g->gid, layout);
+		e->data.resize(size / sizeof(int));
+		n.getblob(&e->data[0], &size, 0, (char)('A' + layout));
+	}
+	e->used = ++stamp;
+	return lc_apply(g, hash, e->data);
+}
+
+void lc_store(mutable_graph_t *g, int layout)
+{
+	lc_entry_t *e = lc_slot(g->gid, layout);
+	netnode n = lc_node(g->gid, true);
+	char tag = (char)('A' + layout);
+
+	lc_save(g, lc_hash(g, layout), e->data);
+	e->used = ++stamp;
+	n.delblob(0, tag);
+	n.setblob(&e->data[0], e->data.size() * sizeof(int), 0, tag);
+}
+
+void lc_clear(void)
+{
+	netnode main(LC_NODE);
+	nodeidx_t id;
+
+	for ( int i=0; i<LC_SIZE; i++ )
+	{
+		lru[i].used = 0;
+		lru[i].data.clear();
+	}
+	if ( main == BADNODE )
+		return;
+	for ( nodeidx_t gid=main.sup1st('N'); gid != BADNODE; gid=main.supnxt(gid, 'N') )
+	{
+		if ( main.supval(gid, &id, sizeof(id), 'N') == sizeof(id) )
+			netnode(id).kill();
+	}
+	main.kill();
+}
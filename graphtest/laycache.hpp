@@ -0,0 +1,25 @@
+/*
+ *	laycache.hpp
+ *	------------
+ *	Cache of computed graph layouts (node rectangles and
+ *	edge bends), keyed by the graph id, the layout type
+ *	and a hash of the graph's nodes and edges.
+ *	The most recently used layouts are kept in memory,
+ *	all of them in the database.
+ *
+ */
+
+#ifndef __LAYCACHE_HPP
+#define __LAYCACHE_HPP
+
+// applies the cached layout of g, false if there is none
+// or the graph changed since it was stored
+bool lc_restore(mutable_graph_t *g, int layout);
+
+// remembers the current layout of g
+void lc_store(mutable_graph_t *g, int layout);
+
+// forgets all layouts, in memory and in the database
+void lc_clear(void);
+
+#endif // __LAYCACHE_HPP
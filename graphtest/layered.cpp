@@ -0,0 +1,642 @@
+/*
+ *	layered.cpp
+ *	-----------
+ *	See layered.hpp. Nothing is recursive, the depth first
+ *	searches and the block placement of Brandes-Koepf use
+ *	explicit stacks and a topological order instead.
+ *
+ *	References:
+ *	E. Gansner et al., "A Technique for Drawing Directed Graphs", 1993
+ *	W. Barth, M. Juenger, P. Mutzel, "Simple and Efficient
+ *	  Bilayer Cross Counting", 2002
+ *	U. Brandes, B. Koepf, "Fast and Simple Horizontal
+ *	  Coordinate Assignment", 2001
+ *
+ */
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include "layered.hpp"
+
+//--------------------------------------------------------------------------
+// 1.) reverses the edges closing a cycle in a depth first search,
+// started at the nodes without predecessors first
+void layered_layout_t::remove_cycles(const int *succ_off, const int *succ)
+{
+	state.assign(n, 0);
+	iter.resize(n);
+	reversed.assign(nedges, 0);
+	efrom.resize(nedges);
+	eto.resize(nedges);
+
+	indeg.assign(n, 0);
+	for ( int k=0; k<nedges; k++ )
+		indeg[succ[k]]++;
+
+	for ( int pass=0; pass<2; pass++ )
+	{
+		for ( int s=0; s<n; s++ )
+		{
+			if ( state[s] != 0 || (pass == 0 && indeg[s] != 0) )
+				continue;
+			state[s] = 1;
+			iter[s] = succ_off[s];
+			stack.clear();
+			stack.push_back(s);
+			while ( !stack.empty() )
+			{
+				int v = stack.back();
+				if ( iter[v] < succ_off[v+1] )
+				{
+					int k = iter[v]++;
+					int t = succ[k];
+					if ( state[t] == 1 )
+						reversed[k] = 1;		// self loops as well
+					else if ( state[t] == 0 )
+					{
+						state[t] = 1;
+						iter[t] = succ_off[t];
+						stack.push_back(t);
+					}
+				}
+				else
+				{
+					state[v] = 2;
+					stack.pop_back();
+				}
+			}
+		}
+	}
+
+	for ( int v=0; v<n; v++ )
+	{
+		for ( int k=succ_off[v]; k<succ_off[v+1]; k++ )
+		{
+			efrom[k] = reversed[k] ? succ[k] : v;
+			eto[k] = reversed[k] ? v : succ[k];
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+// 2.) a node is one layer below its lowest predecessor
+void layered_layout_t::assign_layers(void)
+{
+	eoff.assign(n + 1, 0);
+	for ( int k=0; k<nedges; k++ )
+		if ( efrom[k] != eto[k] )
+			eoff[efrom[k] + 1]++;
+	for ( int v=0; v<n; v++ )
+		eoff[v + 1] += eoff[v];
+	eout.resize(eoff[n]);
+	iter.assign(eoff.begin(), eoff.end() - 1);
+	indeg.assign(n, 0);
+	for ( int k=0; k<nedges; k++ )
+	{
+		if ( efrom[k] != eto[k] )
+		{
+			eout[iter[efrom[k]]++] = k;
+			indeg[eto[k]]++;
+		}
+	}
+
+	layer.assign(n, 0);
+	queue.clear();
+	for ( int v=0; v<n; v++ )
+		if ( indeg[v] == 0 )
+			queue.push_back(v);
+	nlayers = n != 0 ? 1 : 0;
+	for ( size_t i=0; i<queue.size(); i++ )
+	{
+		int u = queue[i];
+		for ( int j=eoff[u]; j<eoff[u+1]; j++ )
+		{
+			int t = eto[eout[j]];
+			if ( layer[t] < layer[u] + 1 )
+			{
+				layer[t] = layer[u] + 1;
+				if ( layer[t] + 1 > nlayers )
+					nlayers = layer[t] + 1;
+			}
+			if ( --indeg[t] == 0 )
+				queue.push_back(t);
+		}
+	}
+}
+
+// splits edges spanning several layers by dummy nodes
+void layered_layout_t::make_proper(void)
+{
+	N = n;
+	chain_off.assign(1, 0);
+	chain.clear();
+	seg_upper.clear();
+	seg_lower.clear();
+	for ( int k=0; k<nedges; k++ )
+	{
+		int a = efrom[k], b = eto[k];
+		if ( a != b )
+		{
+			int prev = a;
+			for ( int l=layer[a]+1; l<layer[b]; l++ )
+			{
+				layer.push_back(l);
+				chain.push_back(N);
+				seg_upper.push_back(prev);
+				seg_lower.push_back(N);
+				prev = N++;
+			}
+			seg_upper.push_back(prev);
+			seg_lower.push_back(b);
+		}
+		chain_off.push_back((int)chain.size());
+	}
+	ndummies = N - n;
+	width.resize(N, 0);
+	height.resize(N, 0);
+
+	// neighbours in both directions, with their segment
+	int S = (int)seg_upper.size();
+	up_off.assign(N + 1, 0);
+	down_off.assign(N + 1, 0);
+	for ( int s=0; s<S; s++ )
+	{
+		up_off[seg_lower[s] + 1]++;
+		down_off[seg_upper[s] + 1]++;
+	}
+	for ( int v=0; v<N; v++ )
+	{
+		up_off[v + 1] += up_off[v];
+		down_off[v + 1] += down_off[v];
+	}
+	up.resize(S);
+	up_seg.resize(S);
+	down.resize(S);
+	down_seg.resize(S);
+	iter.assign(up_off.begin(), up_off.end() - 1);
+	state.assign(down_off.begin(), down_off.end() - 1);
+	for ( int s=0; s<S; s++ )
+	{
+		int i = iter[seg_lower[s]]++;
+		up[i] = seg_upper[s];
+		up_seg[i] = s;
+		i = state[seg_upper[s]]++;
+		down[i] = seg_lower[s];
+		down_seg[i] = s;
+	}
+}
+
+//--------------------------------------------------------------------------
+// 3.) the first order: depth first, children next to each other
+void layered_layout_t::initial_order(void)
+{
+	tmp.clear();
+	state.assign(N, 0);
+	iter.resize(N);
+	for ( int s=0; s<N; s++ )
+	{
+		if ( state[s] != 0 || up_off[s] != up_off[s+1] )
+			continue;
+		state[s] = 1;
+		tmp.push_back(s);
+		iter[s] = down_off[s];
+		stack.clear();
+		stack.push_back(s);
+		while ( !stack.empty() )
+		{
+			int v = stack.back();
+			if ( iter[v] < down_off[v+1] )
+			{
+				int t = down[iter[v]++];
+				if ( state[t] == 0 )
+				{
+					state[t] = 1;
+					tmp.push_back(t);
+					iter[t] = down_off[t];
+					stack.push_back(t);
+				}
+			}
+			else
+				stack.pop_back();
+		}
+	}
+
+	layer_off.assign(nlayers + 1, 0);
+	for ( int v=0; v<N; v++ )
+		layer_off[layer[v] + 1]++;
+	for ( int l=0; l<nlayers; l++ )
+		layer_off[l + 1] += layer_off[l];
+	order.resize(N);
+	pos.resize(N);
+	iter.assign(layer_off.begin(), layer_off.end() - 1);
+	for ( size_t i=0; i<tmp.size(); i++ )
+	{
+		int v = tmp[i];
+		pos[v] = iter[layer[v]] - layer_off[layer[v]];
+		order[iter[layer[v]]++] = v;
+	}
+}
+
+struct by_bary
+{
+	const double *bary;
+	by_bary(const double *b) : bary(b) {}
+	bool operator()(int a, int b) const { return bary[a] < bary[b]; }
+};
+
+// orders layer l by the mean position of the neighbours above
+// (use_up) or below, nodes without any keep their place
+void layered_layout_t::sort_layer(int l, bool use_up)
+{
+	const std::vector<int> &off = use_up ? up_off : down_off;
+	const std::vector<int> &nb = use_up ? up : down;
+
+	for ( int i=layer_off[l]; i<layer_off[l+1]; i++ )
+	{
+		int v = order[i];
+		if ( off[v] == off[v+1] )
+			bary[v] = pos[v];
+		else
+		{
+			double sum = 0;
+			for ( int j=off[v]; j<off[v+1]; j++ )
+				sum += pos[nb[j]];
+			bary[v] = sum / (off[v+1] - off[v]);
+		}
+	}
+	std::stable_sort(order.begin() + layer_off[l], order.begin() + layer_off[l+1], by_bary(&bary[0]));
+	for ( int i=layer_off[l]; i<layer_off[l+1]; i++ )
+		pos[order[i]] = i - layer_off[l];
+}
+
+// Barth, Juenger, Mutzel: the positions below, in the order of
+// the segments sorted by both ends, and an accumulator tree
+long layered_layout_t::count_crossings(void)
+{
+	long total = 0;
+
+	for ( int l=0; l+1<nlayers; l++ )
+	{
+		tmp.clear();
+		for ( int i=layer_off[l]; i<layer_off[l+1]; i++ )
+		{
+			int v = order[i];
+			size_t first = tmp.size();
+			for ( int j=down_off[v]; j<down_off[v+1]; j++ )
+				tmp.push_back(pos[down[j]]);
+			std::sort(tmp.begin() + first, tmp.end());
+		}
+
+		int q = layer_off[l+2] - layer_off[l+1];
+		int first = 1;
+		while ( first < q )
+			first *= 2;
+		tree.assign(2 * first - 1, 0);
+		first--;
+		for ( size_t i=0; i<tmp.size(); i++ )
+		{
+			int index = tmp[i] + first;
+			tree[index]++;
+			while ( index > 0 )
+			{
+				if ( index % 2 != 0 )
+					total += tree[index + 1];
+				index = (index - 1) / 2;
+				tree[index]++;
+			}
+		}
+	}
+	return total;
+}
+
+void layered_layout_t::reduce_crossings(void)
+{
+	bary.resize(N);
+	best = order;
+	crossings = count_crossings();
+	for ( int s=0; s<max_sweeps && crossings != 0; s++ )
+	{
+		for ( int l=1; l<nlayers; l++ )
+			sort_layer(l, true);
+		for ( int l=nlayers-2; l>=0; l-- )
+			sort_layer(l, false);
+		long c = count_crossings();
+		if ( c >= crossings )
+			break;
+		crossings = c;
+		best = order;
+	}
+	order = best;
+	for ( int l=0; l<nlayers; l++ )
+		for ( int i=layer_off[l]; i<layer_off[l+1]; i++ )
+			pos[order[i]] = i - layer_off[l];
+}
+
+// neighbour lists in the final order, for the medians
+void layered_layout_t::sort_neighbours(void)
+{
+	std::vector<int> *lists[2][2] = { { &up_off, &up }, { &down_off, &down } };
+	std::vector<int> *segs[2] = { &up_seg, &down_seg };
+
+	for ( int d=0; d<2; d++ )
+	{
+		const std::vector<int> &off = *lists[d][0];
+		std::vector<int> &nb = *lists[d][1];
+		std::vector<int> &sg = *segs[d];
+		for ( int v=0; v<N; v++ )
+		{
+			// short lists, insertion sort
+			for ( int i=off[v]+1; i<off[v+1]; i++ )
+			{
+				int a = nb[i], s = sg[i], j = i;
+				for ( ; j>off[v] && pos[nb[j-1]] > pos[a]; j-- )
+				{
+					nb[j] = nb[j-1];
+					sg[j] = sg[j-1];
+				}
+				nb[j] = a;
+				sg[j] = s;
+			}
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+// 4.) type 1 conflicts: segments crossing an inner segment (between
+// two dummies) are not used for alignment, so long edges stay straight
+void layered_layout_t::mark_conflicts(void)
+{
+	marked.assign(seg_upper.size(), 0);
+	for ( int l=0; l+1<nlayers; l++ )
+	{
+		int lower = layer_off[l+1];
+		int m = layer_off[l+2] - lower;
+		int k0 = 0, li = 0;
+		for ( int l1=0; l1<m; l1++ )
+		{
+			int v = order[lower + l1];
+			int inner = -1;
+			if ( v >= n && up_off[v+1] - up_off[v] == 1 && up[up_off[v]] >= n )
+				inner = up[up_off[v]];
+			if ( l1 != m - 1 && inner < 0 )
+				continue;
+			int k1 = inner >= 0 ? pos[inner] : layer_off[l+1] - layer_off[l] - 1;
+			for ( ; li<=l1; li++ )
+			{
+				int w = order[lower + li];
+				for ( int j=up_off[w]; j<up_off[w+1]; j++ )
+					if ( pos[up[j]] < k0 || pos[up[j]] > k1 )
+						marked[up_seg[j]] = 1;
+			}
+			k0 = k1;
+		}
+	}
+}
+
+// distance of the centers of a and b, neighbours in a layer
+int layered_layout_t::sep(int a, int b) const
+{
+	return (width[a] + width[b]) / 2 + (a >= n || b >= n ? edge_gap : node_gap);
+}
+
+// one of the four layouts: variant & 1 = aligned to the right,
+// variant & 2 = aligned to the neighbours below
+void layered_layout_t::place(int variant, std::vector<int> &xv)
+{
+	bool right = (variant & 1) != 0;
+	bool below = (variant & 2) != 0;
+	const std::vector<int> &off = below ? down_off : up_off;
+	const std::vector<int> &nb = below ? down : up;
+	const std::vector<int> &sg = below ? down_seg : up_seg;
+
+	vpos.resize(N);
+	left.resize(N);
+	root.resize(N);
+	align.resize(N);
+	for ( int l=0; l<nlayers; l++ )
+	{
+		int size = layer_off[l+1] - layer_off[l];
+		for ( int i=layer_off[l]; i<layer_off[l+1]; i++ )
+		{
+			int v = order[i];
+			vpos[v] = right ? size - 1 - pos[v] : pos[v];
+			if ( right )
+				left[v] = i + 1 < layer_off[l+1] ? order[i+1] : -1;
+			else
+				left[v] = i > layer_off[l] ? order[i-1] : -1;
+		}
+	}
+	for ( int v=0; v<N; v++ )
+		root[v] = align[v] = v;
+
+	// vertical alignment with the medians
+	for ( int s=1; s<nlayers; s++ )
+	{
+		int l = below ? nlayers - 1 - s : s;
+		int size = layer_off[l+1] - layer_off[l];
+		int r = -1;
+		for ( int k=0; k<size; k++ )
+		{
+			int v = order[layer_off[l] + (right ? size - 1 - k : k)];
+			int d = off[v+1] - off[v];
+			if ( d == 0 )
+				continue;
+			int meds[2] = { (d - 1) / 2, d / 2 };
+			for ( int m=0; m<2; m++ )
+			{
+				if ( m == 1 && meds[1] == meds[0] )
+					break;
+				if ( align[v] != v )
+					break;
+				int j = off[v] + (right ? d - 1 - meds[m] : meds[m]);
+				int u = nb[j];
+				if ( !marked[sg[j]] && r < vpos[u] )
+				{
+					align[u] = v;
+					root[v] = root[u];
+					align[v] = root[v];
+					r = vpos[u];
+				}
+			}
+		}
+	}
+
+	// horizontal compaction, the blocks in topological order of
+	// "left of": the same as the recursion of the paper
+	boff.assign(N + 1, 0);
+	for ( int v=0; v<N; v++ )
+		if ( left[v] >= 0 )
+			boff[root[left[v]] + 1]++;
+	for ( int v=0; v<N; v++ )
+		boff[v + 1] += boff[v];
+	bgraph.resize(boff[N]);
+	iter.assign(boff.begin(), boff.end() - 1);
+	bdeg.assign(N, 0);
+	for ( int v=0; v<N; v++ )
+	{
+		if ( left[v] >= 0 )
+		{
+			bgraph[iter[root[left[v]]]++] = root[v];
+			bdeg[root[v]]++;
+		}
+	}
+
+	const long INF = LONG_MAX;
+	sink.resize(N);
+	shift.assign(N, INF);
+	bx.assign(N, 0);
+	for ( int v=0; v<N; v++ )
+		sink[v] = v;
+	queue.clear();
+	for ( int v=0; v<N; v++ )
+		if ( root[v] == v && bdeg[v] == 0 )
+			queue.push_back(v);
+	for ( size_t i=0; i<queue.size(); i++ )
+	{
+		int v = queue[i];
+		int w = v;
+		do
+		{
+			if ( left[w] >= 0 )
+			{
+				int u = root[left[w]];
+				long delta = sep(left[w], w);
+				if ( sink[v] == v )
+					sink[v] = sink[u];
+				if ( sink[v] != sink[u] )
+					shift[sink[u]] = std::min(shift[sink[u]], bx[v] - bx[u] - delta);
+				else
+					bx[v] = std::max(bx[v], bx[u] + delta);
+			}
+			w = align[w];
+		} while ( w != v );
+
+		for ( int j=boff[v]; j<boff[v+1]; j++ )
+			if ( --bdeg[bgraph[j]] == 0 )
+				queue.push_back(bgraph[j]);
+	}
+
+	xv.resize(N);
+	for ( int v=0; v<N; v++ )
+	{
+		long xx = bx[root[v]];
+		if ( shift[sink[root[v]]] < INF )
+			xx += shift[sink[root[v]]];
+		xv[v] = (int)(right ? -xx : xx);
+	}
+}
+
+// balances the four layouts: each one is moved onto the narrowest,
+// a node gets the mean of its two median positions
+void layered_layout_t::assign_x(void)
+{
+	int lo[4], hi[4], narrow = 0;
+
+	mark_conflicts();
+	for ( int k=0; k<4; k++ )
+	{
+		place(k, xs[k]);
+		lo[k] = INT_MAX;
+		hi[k] = INT_MIN;
+		for ( int v=0; v<N; v++ )
+		{
+			lo[k] = std::min(lo[k], xs[k][v] - width[v] / 2);
+			hi[k] = std::max(hi[k], xs[k][v] + width[v] / 2);
+		}
+		if ( hi[k] - lo[k] < hi[narrow] - lo[narrow] )
+			narrow = k;
+	}
+	for ( int k=0; k<4; k++ )
+	{
+		int d = (k & 1) != 0 ? hi[narrow] - hi[k] : lo[narrow] - lo[k];
+		for ( int v=0; v<N; v++ )
+			xs[k][v] += d;
+	}
+
+	med.resize(N);
+	for ( int v=0; v<N; v++ )
+	{
+		int c[4] = { xs[0][v], xs[1][v], xs[2][v], xs[3][v] };
+		std::sort(c, c + 4);
+		med[v] = (c[1] + c[2]) / 2;
+	}
+	// the mean of valid layouts isn't always valid
+	for ( int l=0; l<nlayers; l++ )
+		for ( int i=layer_off[l]+1; i<layer_off[l+1]; i++ )
+			med[order[i]] = std::max(med[order[i]], med[order[i-1]] + sep(order[i-1], order[i]));
+}
+
+// the layers from the top, nodes centered in them, and the bends
+void layered_layout_t::assign_y_and_bends(void)
+{
+	int minx = INT_MAX;
+	std::vector<int> &top = tmp;
+
+	top.assign(nlayers + 1, 0);
+	for ( int v=0; v<n; v++ )
+		top[layer[v] + 1] = std::max(top[layer[v] + 1], height[v]);
+	for ( int l=0; l<nlayers; l++ )
+		top[l + 1] += top[l] + layer_gap;
+	for ( int v=0; v<N; v++ )
+		minx = std::min(minx, med[v] - width[v] / 2);
+
+	x.resize(n);
+	y.resize(n);
+	for ( int v=0; v<n; v++ )
+	{
+		x[v] = med[v] - width[v] / 2 - minx;
+		y[v] = top[layer[v]] + (top[layer[v] + 1] - layer_gap - top[layer[v]] - height[v]) / 2;
+	}
+
+	bend_off.assign(1, 0);
+	bends.clear();
+	for ( int k=0; k<nedges; k++ )
+	{
+		int a = efrom[k], b = eto[k];
+		if ( a != b )
+		{
+			size_t first = bends.size();
+			bends.push_back(x[a] + width[a] / 2);
+			bends.push_back(y[a] + height[a]);
+			for ( int i=chain_off[k]; i<chain_off[k+1]; i++ )
+			{
+				int d = chain[i];
+				bends.push_back(med[d] - minx);
+				bends.push_back((top[layer[d]] + top[layer[d] + 1] - layer_gap) / 2);
+			}
+			bends.push_back(x[b] + width[b] / 2);
+			bends.push_back(y[b]);
+			if ( reversed[k] )
+			{
+				// from the source of the edge, pairs stay pairs
+				std::reverse(bends.begin() + first, bends.end());
+				for ( size_t i=first; i<bends.size(); i+=2 )
+					std::swap(bends[i], bends[i+1]);
+			}
+		}
+		bend_off.push_back((int)bends.size());
+	}
+}
+
+//--------------------------------------------------------------------------
+void layered_layout_t::compute(int _n, const int *w, const int *h, const int *succ_off, const int *succ)
+{
+	n = _n;
+	nedges = n != 0 ? succ_off[n] : 0;
+	nlayers = 0;
+	ndummies = 0;
+	crossings = 0;
+	width.assign(w, w + n);
+	height.assign(h, h + n);
+
+	remove_cycles(succ_off, succ);
+	assign_layers();
+	make_proper();
+	initial_order();
+	reduce_crossings();
+	sort_neighbours();
+	assign_x();
+	assign_y_and_bends();
+}
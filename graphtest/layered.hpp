@@ -0,0 +1,94 @@
+/*
+ *	layered.hpp
+ *	-----------
+ *	Layered (Sugiyama style) layout of a directed graph,
+ *	for graphs too big for the built-in digraph layout:
+ *
+ *	1.) cycle removal: edges closing a cycle in a depth
+ *	    first search are reversed
+ *	2.) longest path layering, long edges are split by
+ *	    dummy nodes into segments between adjacent layers
+ *	3.) crossing reduction: barycenter sweeps down and up,
+ *	    at most max_sweeps of them, the order with the
+ *	    fewest crossings is kept
+ *	4.) x coordinates by Brandes-Koepf: four alignments
+ *	    along the medians, horizontal compaction, balanced
+ *
+ *	Everything works on flat arrays which keep their memory
+ *	between layouts. Doesn't need IDA, so the tools can use
+ *	it as well.
+ *
+ */
+
+#ifndef __LAYERED_HPP
+#define __LAYERED_HPP
+
+#include <vector>
+
+class layered_layout_t
+{
+public:
+	// spacing
+	int node_gap;		// between the nodes of a layer
+	int edge_gap;		// between edges passing through a layer
+	int layer_gap;		// between layers
+	int max_sweeps;		// of the crossing reduction
+
+	// results, node positions are the top left corners
+	std::vector<int> x, y;
+	// bends of every edge (in the order of 'succ'), x/y pairs
+	// from the source to the target, both ends included
+	std::vector<int> bend_off, bends;
+	int nlayers;
+	int ndummies;
+	long crossings;
+
+	layered_layout_t(void) : node_gap(40), edge_gap(12), layer_gap(60), max_sweeps(8) {}
+
+	// n nodes with widths w and heights h, edges in compressed
+	// sparse row form: the successors of v are
+	// succ[succ_off[v]] .. succ[succ_off[v+1]-1]
+	void compute(int n, const int *w, const int *h, const int *succ_off, const int *succ);
+
+private:
+	int n, N;					// nodes, nodes with dummies
+	int nedges;
+	std::vector<int> width, height;
+	// 1.) and 2.)
+	std::vector<int> state, stack, iter;
+	std::vector<char> reversed;	// per edge
+	std::vector<int> efrom, eto;	// per edge, after reversing
+	std::vector<int> eoff, eout;	// edges leaving a node, after reversing
+	std::vector<int> layer, indeg, queue;
+	std::vector<int> chain_off, chain;	// per edge: its dummies, top down
+	// the proper layered graph, segments between adjacent layers
+	std::vector<int> up_off, up, down_off, down;	// neighbours, segment ids in *_seg
+	std::vector<int> up_seg, down_seg;
+	std::vector<int> seg_upper, seg_lower;
+	std::vector<char> marked;	// type 1 conflicts, per segment
+	// 3.)
+	std::vector<int> layer_off, order, pos, best;
+	std::vector<double> bary;
+	std::vector<int> tree, tmp;
+	// 4.)
+	std::vector<int> root, align, sink, vpos, left, xs[4];
+	std::vector<long> shift, bx;
+	std::vector<int> boff, bgraph, bdeg;
+	std::vector<int> med;
+
+	void remove_cycles(const int *succ_off, const int *succ);
+	void assign_layers(void);
+	void make_proper(void);
+	void initial_order(void);
+	void sort_layer(int l, bool use_up);
+	long count_crossings(void);
+	void reduce_crossings(void);
+	void sort_neighbours(void);
+	void mark_conflicts(void);
+	int sep(int a, int b) const;
+	void place(int variant, std::vector<int> &xv);
+	void assign_x(void);
+	void assign_y_and_bends(void);
+};
+
+#endif // __LAYERED_HPP
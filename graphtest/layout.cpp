@@ -5,8 +5,8 @@
  *	shows you how to use the new graphing interface
  *	and some of its new callbacks.
  *	The plugin adds an item to the graph's popup-menu
- *	and lets you choose between one of three layout
- *	algorithms (circle, tree and digraph).
+ *	and lets you choose between one of four layout
+ *	algorithms (circle, tree, digraph and layered).
  *
  *	Author: Dennis Elser
  *
@@ -17,6 +17,13 @@
  *	--------
  *
  *	19.03.2006 - initial release
+ *	19.10.2026 - layouts are cached by graph content and kept
+ *	             in the database (laycache.cpp), switching back
+ *	             to a function which didn't change reuses its
+ *	             layout. Run with argument 1 to forget them.
+ *	19.10.2026 - "Layered", a layout of our own (layered.cpp)
+ *	             for graphs with thousands of nodes, where the
+ *	             digraph layout takes far too long.
  *
  */
 
@@ -29,6 +36,9 @@
 #include <loader.hpp>
 #include <kernwin.hpp>
 
+#include "laycache.hpp"
+#include "layered.hpp"
+
 //--------------------------------------------------------------------------
 static bool hooked = false;
 static bool newmenu = false;
@@ -39,6 +49,24 @@ static graph_viewer_t *gv = NULL;
 
 #define MENU_ITEM_CAPTION "Set layout"
 
+// our own layout, not one of IDA's layout_type_t
+#define LAYOUT_LAYERED 16
+
+static layered_layout_t layered;
+
+const char layout_dlg[] =
+	"STARTITEM 0\n"
+	"Set layout\n"
+	"Please select layout type\n\n"
+	"<Circle:R>\n"
+	"<Tree:R>\n"
+	"<Digraph:R>\n"
+	"<#Fast, for graphs with thousands of nodes.#"
+	"Layered:R>>\n\n";
+
+// in the order of the radio buttons
+static const int dlg_layouts[] = { layout_circle, layout_tree, layout_digraph, LAYOUT_LAYERED };
+
 //--------------------------------------------------------------------------
 void doCircleLayout(mutable_graph_t *g, point_t center, int radius)
 {
@@ -74,33 +102,95 @@ void doDigraphLayout(mutable_graph_t *g)
 
 
 //--------------------------------------------------------------------------
-// callback function for layout selection
-bool idaapi menu_callback(void *ud)
+void doLayeredLayout(mutable_graph_t *g)
 {
-	mutable_graph_t *g = get_viewer_graph(gv);
-	if( g == NULL )
-		return false;
-	
-	int code = askbuttons_c("Circle", "Tree", "Digraph", 1, "Please select layout type");
-	
-	// code is being converted to a globally "useful" variable
-	switch( code  )
+	int n = g->size();
+	std::vector<int> w(n), h(n), succ_off(n + 1, 0), succ;
+
+	for( int i=0; i<n; i++ )
+	{
+		w[i] = g->nodes[i].width();
+		h[i] = g->nodes[i].height();
+		for( int k=0; k<g->nsucc(i); k++ )
+			succ.push_back(g->succ(i, k));
+		succ_off[i+1] = (int)succ.size();
+	}
+	if( n == 0 )
+		return;
+	layered.compute(n, &w[0], &h[0], &succ_off[0], succ.empty() ? NULL : &succ[0]);
+
+	for( int i=0; i<n; i++ )
+		g->nodes[i].move_to(point_t(layered.x[i], layered.y[i]));
+	for( int i=0; i<n; i++ )
+	{
+		for( int k=succ_off[i]; k<succ_off[i+1]; k++ )
+		{
+			edge_info_t *ei = g->get_edge(edge_t(i, succ[k]));
+			if( ei == NULL )
+				continue;
+			ei->srcoff = ei->dstoff = -1;
+			ei->layout.clear();
+			for( int b=layered.bend_off[k]; b<layered.bend_off[k+1]; b+=2 )
+				ei->layout.push_back(point_t(layered.bends[b], layered.bends[b+1]));
+		}
+	}
+	// IDA mustn't lay it out again
+	g->current_layout = layout_none;
+}
+
+
+
+//--------------------------------------------------------------------------
+// lays g out, with the cached layout if the graph didn't change
+void doLayout(mutable_graph_t *g, bool use_cache)
+{
+	if( use_cache && lc_restore(g, layout) )
 	{
-	case 1: // circle
-		layout = layout_circle;
+		g->current_layout = layout == LAYOUT_LAYERED ? layout_none : (layout_type_t)layout;
+		return;
+	}
+
+	switch( layout  )
+	{
+	case layout_circle: // circle
 		// use 200,200 (x/y) as center by default
 		// 2000 as radius by default
 		doCircleLayout(g, point_t(200, 200), 2000);
 		break;
-	case 0: // tree
-		layout = layout_tree;
+	case layout_tree: // tree
 		doTreeLayout(g);
 		break;  
-	case -1: // digraph
-		layout = layout_digraph;
+	case layout_digraph: // digraph
 		doDigraphLayout(g);
 		break;
+	case LAYOUT_LAYERED:
+		doLayeredLayout(g);
+		break;
 	}
+	lc_store(g, layout);
+}
+
+
+
+//--------------------------------------------------------------------------
+// callback function for layout selection
+bool idaapi menu_callback(void *ud)
+{
+	mutable_graph_t *g = get_viewer_graph(gv);
+	if( g == NULL )
+		return false;
+	
+	short code = 0;
+	for( size_t i=0; i<qnumber(dlg_layouts); i++ )
+		if( dlg_layouts[i] == layout )
+			code = (short)i;
+	if( AskUsingForm_c(layout_dlg, &code) != 1 )
+		return true;
+	
+	// code is being converted to a globally "useful" variable
+	layout = dlg_layouts[code];
+	// the user asked for it, so it is always laid out again
+	doLayout(g, false);
 	
 	refresh_viewer(gv);
 	return true;
@@ -146,18 +236,7 @@ static int idaapi callback(void *, int code, va_list va)
 			if( g == NULL )
 				break;
 			
-			switch( layout  )
-			{
-			case layout_circle: // circle
-				doCircleLayout(g, point_t(200, 200), 2000);
-				break;
-			case layout_tree: // tree
-				doTreeLayout(g);
-				break;  
-			case layout_digraph: // digraph
-				doDigraphLayout(g);
-				break;
-			}	
+			doLayout(g, true);
 		}
 		break;
 	}
@@ -182,8 +261,14 @@ void idaapi term(void)
 }
 
 //--------------------------------------------------------------------------
-void idaapi run(int /*arg*/)
+void idaapi run(int arg)
 {
+	if( arg == 1 )
+	{
+		lc_clear();
+		msg("Cached graph layouts deleted.\n");
+		return;
+	}
 	msg("Additional graph layouts are %s.\n"
 		"Right click on a graph and select \"%s\".",
 		(newmenu) ? "enabled" : "disabled",
@@ -0,0 +1,132 @@
+/*
+ *	layoutbench.cpp
+ *	---------------
+ *	Times the layered layout (layered.cpp) on synthetic
+ *	flowgraphs: a chain of blocks with branches, loops and
+ *	now and then a far jump, the nodes sized like blocks of
+ *	disassembly. Checks that no two nodes overlap.
+ *
+ *	Build (Linux):
+ *	  g++ -O2 -o layoutbench layoutbench.cpp ../layered.cpp
+ *
+ *	Usage:
+ *	  layoutbench [nodes ...]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "../layered.hpp"
+
+//--------------------------------------------------------------------------
+static unsigned int rnd_state = 4711;
+
+static unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void make_graph(int n, std::vector<int> &w, std::vector<int> &h,
+					   std::vector<int> &succ_off, std::vector<int> &succ)
+{
+	w.resize(n);
+	h.resize(n);
+	succ_off.assign(1, 0);
+	succ.clear();
+	for ( int i=0; i<n; i++ )
+	{
+		w[i] = 80 + rnd(200);
+		h[i] = 16 + 14 * rnd(12);
+		size_t first = succ.size();
+		if ( i + 1 < n && rnd(10) < 8 )
+			succ.push_back(i + 1);
+		if ( rnd(2) == 0 )
+		{
+			// mostly short branches and loops
+			int to = i + (int)rnd(24) - 8;
+			if ( rnd(100) == 0 )
+				to = rnd(n);
+			if ( to >= 0 && to < n )
+				succ.push_back(to);
+		}
+		std::sort(succ.begin() + first, succ.end());
+		succ.erase(std::unique(succ.begin() + first, succ.end()), succ.end());
+		succ_off.push_back((int)succ.size());
+	}
+}
+
+// no two nodes may overlap: sorted by x, every node is compared
+// with the ones starting before its right end
+struct by_x
+{
+	const std::vector<int> &x;
+	by_x(const std::vector<int> &_x) : x(_x) {}
+	bool operator()(int a, int b) const { return x[a] < x[b]; }
+};
+
+static bool check(const layered_layout_t &lay, const std::vector<int> &w, const std::vector<int> &h)
+{
+	int n = (int)w.size();
+	std::vector<int> idx(n);
+
+	for ( int i=0; i<n; i++ )
+	{
+		idx[i] = i;
+		if ( lay.x[i] < 0 || lay.y[i] < 0 )
+			return false;
+	}
+	std::sort(idx.begin(), idx.end(), by_x(lay.x));
+	for ( int i=0; i<n; i++ )
+	{
+		int a = idx[i];
+		for ( int j=i+1; j<n && lay.x[idx[j]] < lay.x[a] + w[a]; j++ )
+		{
+			int b = idx[j];
+			if ( lay.y[b] < lay.y[a] + h[a] && lay.y[a] < lay.y[b] + h[b] )
+				return false;
+		}
+	}
+	return true;
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	static const int defaults[] = { 100, 1000, 10000, 20000 };
+	std::vector<int> sizes, w, h, succ_off, succ;
+	layered_layout_t lay;
+
+	for ( int i=1; i<argc; i++ )
+		sizes.push_back(atoi(argv[i]));
+	if ( sizes.empty() )
+		sizes.assign(defaults, defaults + sizeof(defaults)/sizeof(defaults[0]));
+
+	printf("%8s %8s %8s %8s %10s %10s\n", "nodes", "edges", "layers", "dummies", "crossings", "ms");
+	for ( size_t i=0; i<sizes.size(); i++ )
+	{
+		make_graph(sizes[i], w, h, succ_off, succ);
+		double t = now_ms();
+		lay.compute(sizes[i], &w[0], &h[0], &succ_off[0], succ.empty() ? NULL : &succ[0]);
+		t = now_ms() - t;
+		printf("%8d %8d %8d %8d %10ld %10.1f\n", sizes[i], (int)succ.size(), lay.nlayers,
+			lay.ndummies, lay.crossings, t);
+		if ( !check(lay, w, h) )
+		{
+			fprintf(stderr, "layoutbench: nodes overlap\n");
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,43 @@
+/*
+ *	Graphtest 2 - block index
+ *
+ *  Maps the start address of a basic block to its node
+ *  number. The blocks are numbered in address order, so
+ *  the index is a sorted array and a lookup is a binary
+ *  search instead of a walk over all blocks.
+ *
+ *  Doesn't need IDA, only a definition of ea_t, so the
+ *  benchmark in tools/ can use it as well.
+ *
+ */
+
+#ifndef __BLOCKIDX_HPP
+#define __BLOCKIDX_HPP
+
+#include <vector>
+#include <algorithm>
+
+class block_index_t
+{
+	std::vector<ea_t> starts;	// sorted, starts[n] = start of node n
+
+public:
+	void clear(void) { starts.clear(); }
+	void reserve(size_t n) { starts.reserve(n); }
+
+	// blocks must be added in address order
+	void add(ea_t start) { starts.push_back(start); }
+
+	size_t size(void) const { return starts.size(); }
+
+	// node number of the block starting at ea, -1 if there is none
+	int find(ea_t ea) const
+	{
+		std::vector<ea_t>::const_iterator p = std::lower_bound(starts.begin(), starts.end(), ea);
+		if( p == starts.end() || *p != ea )
+			return -1;
+		return (int)(p - starts.begin());
+	}
+};
+
+#endif // __BLOCKIDX_HPP
@@ -0,0 +1,205 @@
+/*
+ *	Graphtest 2 - control flow graphs
+ *
+ *  Basic blocks and edges in compressed sparse row form:
+ *  one array of blocks in address order and, per block,
+ *  an offset into one array of successors. The successors
+ *  are node numbers local to the function.
+ *
+ *  cfg_db_t holds the graphs of many functions the same
+ *  way, one more offset array tells where the blocks of
+ *  each function start. cfg_view_t is a single function
+ *  in either of them, the analyses only work on views.
+ *
+ *  Doesn't need IDA, so the tools can use it as well.
+ *
+ */
+
+#ifndef __CFG_HPP
+#define __CFG_HPP
+
+#include <string.h>
+#include <vector>
+
+#ifndef __IDP__
+// outside IDA (tools)
+typedef unsigned int ea_t;
+typedef unsigned int uint32;
+#endif
+
+#define CFG_VERSION		1
+
+struct cfg_block_t
+{
+	ea_t start;
+	ea_t end;
+	uint32 ninsns;
+	uint32 ncalls;
+	uint32 nmemops;		// operands accessing memory
+};
+
+//--------------------------------------------------------------------------
+// one function, borrowed from a cfg_t or a cfg_db_t
+struct cfg_view_t
+{
+	ea_t func;
+	size_t n;					// number of blocks
+	const cfg_block_t *blocks;
+	const uint32 *succ_off;		// n+1 entries
+	const uint32 *succ;			// indexed by succ_off
+
+	size_t nedges(void) const { return n == 0 ? 0 : succ_off[n] - succ_off[0]; }
+	uint32 nsucc(size_t i) const { return succ_off[i+1] - succ_off[i]; }
+	const uint32 *succ_begin(size_t i) const { return succ + succ_off[i]; }
+	const uint32 *succ_end(size_t i) const { return succ + succ_off[i+1]; }
+
+	// the block at the start of the function, 0 if there is none
+	int entry(void) const
+	{
+		size_t lo = 0, hi = n;
+		while ( lo < hi )
+		{
+			size_t mid = (lo + hi) / 2;
+			if ( blocks[mid].start < func )
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < n && blocks[lo].start == func ? (int)lo : 0;
+	}
+};
+
+//--------------------------------------------------------------------------
+// one function
+struct cfg_t
+{
+	ea_t func;
+	std::vector<cfg_block_t> blocks;
+	std::vector<uint32> succ_off;
+	std::vector<uint32> succ;
+
+	void clear(void)
+	{
+		blocks.clear();
+		succ_off.assign(1, 0);
+		succ.clear();
+	}
+
+	cfg_view_t view(void) const
+	{
+		cfg_view_t v;
+		v.func = func;
+		v.n = blocks.size();
+		v.blocks = v.n != 0 ? &blocks[0] : NULL;
+		v.succ_off = &succ_off[0];
+		v.succ = succ.empty() ? NULL : &succ[0];
+		return v;
+	}
+
+	// flat image: version, blocks, edges, blocks[], succ_off[], succ[]
+	void save(std::vector<unsigned char> &buf) const
+	{
+		uint32 hdr[3] = { CFG_VERSION, (uint32)blocks.size(), (uint32)succ.size() };
+		size_t b = blocks.size() * sizeof(cfg_block_t);
+		size_t o = succ_off.size() * sizeof(uint32);
+		size_t s = succ.size() * sizeof(uint32);
+
+		buf.resize(sizeof(hdr) + b + o + s);
+		unsigned char *p = &buf[0];
+		memcpy(p, hdr, sizeof(hdr));
+		p += sizeof(hdr);
+		if ( b != 0 )
+			memcpy(p, &blocks[0], b);
+		p += b;
+		memcpy(p, &succ_off[0], o);
+		p += o;
+		if ( s != 0 )
+			memcpy(p, &succ[0], s);
+	}
+
+	bool load(const unsigned char *p, size_t size)
+	{
+		uint32 hdr[3];
+
+		if ( size < sizeof(hdr) )
+			return false;
+		memcpy(hdr, p, sizeof(hdr));
+		if ( hdr[1] > size || hdr[2] > size )
+			return false;
+		size_t b = hdr[1] * sizeof(cfg_block_t);
+		size_t o = (hdr[1] + 1) * sizeof(uint32);
+		size_t s = hdr[2] * sizeof(uint32);
+		if ( hdr[0] != CFG_VERSION || size != sizeof(hdr) + b + o + s )
+			return false;
+
+		p += sizeof(hdr);
+		blocks.resize(hdr[1]);
+		succ_off.resize(hdr[1] + 1);
+		succ.resize(hdr[2]);
+		if ( b != 0 )
+			memcpy(&blocks[0], p, b);
+		p += b;
+		memcpy(&succ_off[0], p, o);
+		p += o;
+		if ( s != 0 )
+			memcpy(&succ[0], p, s);
+
+		// a broken image must not index past the blocks
+		if ( succ_off[0] != 0 || succ_off[hdr[1]] != hdr[2] )
+			return false;
+		for ( uint32 i=0; i<hdr[1]; i++ )
+			if ( succ_off[i] > succ_off[i+1] )
+				return false;
+		for ( uint32 i=0; i<hdr[2]; i++ )
+			if ( succ[i] >= hdr[1] )
+				return false;
+		return true;
+	}
+};
+
+//--------------------------------------------------------------------------
+// many functions
+struct cfg_db_t
+{
+	std::vector<ea_t> funcs;			// address order
+	std::vector<uint32> func_off;		// funcs.size()+1 entries, into blocks
+	std::vector<cfg_block_t> blocks;
+	std::vector<uint32> succ_off;		// blocks.size()+1 entries, into succ
+	std::vector<uint32> succ;
+
+	void clear(void)
+	{
+		funcs.clear();
+		func_off.assign(1, 0);
+		blocks.clear();
+		succ_off.assign(1, 0);
+		succ.clear();
+	}
+
+	size_t size(void) const { return funcs.size(); }
+
+	void add(const cfg_t &g)
+	{
+		uint32 base = (uint32)succ.size();
+
+		funcs.push_back(g.func);
+		blocks.insert(blocks.end(), g.blocks.begin(), g.blocks.end());
+		func_off.push_back((uint32)blocks.size());
+		for ( size_t i=1; i<g.succ_off.size(); i++ )
+			succ_off.push_back(base + g.succ_off[i]);
+		succ.insert(succ.end(), g.succ.begin(), g.succ.end());
+	}
+
+	cfg_view_t view(size_t f) const
+	{
+		cfg_view_t v;
+		v.func = funcs[f];
+		v.n = func_off[f+1] - func_off[f];
+		v.blocks = v.n != 0 ? &blocks[func_off[f]] : NULL;
+		v.succ_off = &succ_off[func_off[f]];
+		v.succ = succ.empty() ? NULL : &succ[0];
+		return v;
+	}
+};
+
+#endif // __CFG_HPP
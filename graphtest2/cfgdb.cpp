@@ -0,0 +1,287 @@
+/*
+ *	Graphtest 2 - control flow graph cache
+ *
+ *  The graph of a function is stored in a netnode of its
+ *  own, together with a hash of the flags of every byte of
+ *  the function and of the code xrefs of its instructions.
+ *  The flags contain the byte values as well as the item
+ *  boundaries and types, so patching a byte, undefining an
+ *  instruction or turning data into code changes the hash
+ *  and the graph is built again. The xrefs catch new edges
+ *  which don't touch a byte, like a recognized switch table
+ *  or a cref added by the user.
+ *
+ *    "$ graphtest2 cfg"   supval(function, 'N') = node
+ *    node                 supval(0, 'H') = hash
+ *                         blob(0, 'C')   = cfg_t::save()
+ *
+ *  The IDA kernel isn't thread safe, so decoding happens on
+ *  the main thread. Hashing a function is much cheaper than
+ *  decoding it, which is what makes a warm cache fast.
+ *
+ */
+
+#include <windows.h>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <bytes.hpp>
+#include <funcs.hpp>
+#include <ua.hpp>
+#include <xref.hpp>
+#include <kernwin.hpp>
+#include <netnode.hpp>
+
+#include <algorithm>
+
+#include "blockidx.hpp"
+#include "cfgdb.hpp"
+
+#define CFG_NODE	"$ graphtest2 cfg"
+
+//--------------------------------------------------------------------------
+// adds the statistics of the instruction in 'cmd' to b
+static void count_insn(cfg_block_t &b)
+{
+  b.ninsns++;
+  if ( InstrIsSet(cmd.itype, CF_CALL) )
+    b.ncalls++;
+  for ( int i=0; i < UA_MAXOP && cmd.Operands[i].type != o_void; i++ )
+  {
+    optype_t t = cmd.Operands[i].type;
+    if ( t == o_mem || t == o_phrase || t == o_displ )
+      b.nmemops++;
+  }
+}
+
+//--------------------------------------------------------------------------
+// appends the basic blocks between ea1 and ea2 in address order
+static void gather_basic_blocks(ea_t ea1, ea_t ea2, std::vector<cfg_block_t> &blocks)
+{
+  ea_t start = BADADDR;
+  cfg_block_t b;
+  while ( ea1 < ea2 )
+  {
+    memset(&b, 0, sizeof(b));
+    if ( start == BADADDR )
+    {
+      // the block starts at the next instruction, which must be
+      // decoded as well (its statistics count)
+      start = isCode(get_flags_novalue(ea1)) ? ea1 : nextthat(ea1, ea2, f_isCode, NULL);
+      if ( start >= ea2 )
+        break;
+      ea1 = start;
+    }
+    while ( ea1 < ea2 )
+    {
+      if ( !ua_ana0(ea1) )
+        break;
+      count_insn(b);
+      ea1 = get_item_end(ea1);
+      if ( is_basic_block_end(false) )
+        break;
+    }
+    if ( ea1 == start )
+    {
+      // can't be decoded, go on behind it
+      ea1 = get_item_end(ea1);
+      start = BADADDR;
+      continue;
+    }
+    b.start = start;
+    b.end = ea1;
+    blocks.push_back(b);
+    if ( !isCode(get_flags_novalue(ea1)) )
+      start = BADADDR;
+    else
+      start = ea1;
+  }
+}
+
+//--------------------------------------------------------------------------
+void cfg_discover(func_t *f, cfg_t &cfg)
+{
+  block_index_t idx;
+  std::vector<uint32> targets;
+
+  cfg.func = f->startEA;
+  cfg.clear();
+  gather_basic_blocks(f->startEA, f->endEA, cfg.blocks);
+
+  idx.reserve(cfg.blocks.size());
+  for ( size_t i=0; i<cfg.blocks.size(); i++ )
+    idx.add(cfg.blocks[i].start);
+
+  cfg.succ_off.reserve(cfg.blocks.size() + 1);
+  for ( size_t i=0; i<cfg.blocks.size(); i++ )
+  {
+    // the xrefs of the last instruction, switches may
+    // name the same target more than once
+    ea_t last = prevthat(cfg.blocks[i].end, f->startEA, f_isCode, NULL);
+    xrefblk_t xb;
+    targets.clear();
+    for ( bool ok=xb.first_from(last, XREF_ALL); ok; ok=xb.next_from() )
+    {
+      int k = idx.find(xb.to);
+      if ( k >= 0 )
+        targets.push_back((uint32)k);
+    }
+    std::sort(targets.begin(), targets.end());
+    targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+    cfg.succ.insert(cfg.succ.end(), targets.begin(), targets.end());
+    cfg.succ_off.push_back((uint32)cfg.succ.size());
+  }
+}
+
+//--------------------------------------------------------------------------
+static inline uint32 fnv_add(uint32 h, uint32 v)
+{
+  for ( int j=0; j<32; j+=8 )
+    h = (h ^ ((v >> j) & 0xFF)) * 16777619u;
+  return h;
+}
+
+// FNV-1a over the flags of all bytes of f and the
+// jump targets of its instructions
+static uint32 func_hash(func_t *f)
+{
+  uint32 h = 2166136261u;
+
+  h = fnv_add(h, f->endEA - f->startEA);
+  h = fnv_add(h, f->flags);
+  for ( ea_t ea=f->startEA; ea<f->endEA; ea++ )
+  {
+    flags_t F = getFlags(ea);
+    h = fnv_add(h, F);
+    if ( !isCode(F) )
+      continue;
+    xrefblk_t xb;
+    for ( bool ok=xb.first_from(ea, XREF_FAR); ok; ok=xb.next_from() )
+    {
+      if ( xb.iscode )
+      {
+        h = fnv_add(h, xb.to);
+        h = fnv_add(h, xb.type);
+      }
+    }
+  }
+  return h;
+}
+
+// the node of the function at ea, BADNODE if there is none
+static netnode func_node(ea_t ea, bool create)
+{
+  netnode main;
+  nodeidx_t id;
+
+  if ( create )
+    main.create(CFG_NODE);
+  else
+  {
+    main = netnode(CFG_NODE);
+    if ( main == BADNODE )
+      return netnode(BADNODE);
+  }
+  if ( main.supval(ea, &id, sizeof(id), 'N') == sizeof(id) )
+    return netnode(id);
+  if ( !create )
+    return netnode(BADNODE);
+
+  netnode n;
+  n.create();
+  id = n;
+  main.supset(ea, &id, sizeof(id), 'N');
+  return n;
+}
+
+static bool load_cached(func_t *f, uint32 hash, cfg_t &cfg)
+{
+  netnode n = func_node(f->startEA, false);
+  std::vector<unsigned char> buf;
+  uint32 old;
+  size_t size;
+
+  if ( n == BADNODE
+    || n.supval(0, &old, sizeof(old), 'H') != sizeof(old)
+    || old != hash )
+    return false;
+  size = n.blobsize(0, 'C');
+  if ( size == 0 )
+    return false;
+  buf.resize(size);
+  n.getblob(&buf[0], &size, 0, 'C');
+  cfg.func = f->startEA;
+  return cfg.load(&buf[0], size);
+}
+
+static void store(uint32 hash, const cfg_t &cfg)
+{
+  netnode n = func_node(cfg.func, true);
+  std::vector<unsigned char> buf;
+
+  cfg.save(buf);
+  n.delblob(0, 'C');
+  n.setblob(&buf[0], buf.size(), 0, 'C');
+  n.supset(0, &hash, sizeof(hash), 'H');
+}
+
+//--------------------------------------------------------------------------
+static bool get(func_t *f, cfg_t &cfg)
+{
+  uint32 hash = func_hash(f);
+
+  if ( load_cached(f, hash, cfg) )
+    return true;
+  cfg_discover(f, cfg);
+  store(hash, cfg);
+  return false;
+}
+
+void cfg_get(func_t *f, cfg_t &cfg)
+{
+  get(f, cfg);
+}
+
+bool cfg_get_all(cfg_db_t &db, size_t *rebuilt)
+{
+  size_t qty = get_func_qty();
+  cfg_t cfg;
+  bool ok = true;
+
+  *rebuilt = 0;
+  db.clear();
+  show_wait_box("Building the flowgraphs of %u functions", (ulong)qty);
+  for ( size_t i=0; i<qty; i++ )
+  {
+    if ( (i & 255) == 0 )
+    {
+      if ( wasBreak() )
+      {
+        ok = false;
+        break;
+      }
+      showAddr(getn_func(i)->startEA);
+    }
+    func_t *f = getn_func(i);
+    if ( !get(f, cfg) )
+      (*rebuilt)++;
+    db.add(cfg);
+  }
+  hide_wait_box();
+  return ok;
+}
+
+void cfg_drop_cache(void)
+{
+  netnode main(CFG_NODE);
+  nodeidx_t id;
+
+  if ( main == BADNODE )
+    return;
+  for ( nodeidx_t ea=main.sup1st('N'); ea != BADNODE; ea=main.supnxt(ea, 'N') )
+  {
+    if ( main.supval(ea, &id, sizeof(id), 'N') == sizeof(id) )
+      netnode(id).kill();
+  }
+  main.kill();
+}
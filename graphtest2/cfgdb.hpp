@@ -0,0 +1,28 @@
+/*
+ *	Graphtest 2 - control flow graph cache
+ *
+ *  Finds the basic blocks and edges of functions and keeps
+ *  them in the database, so a graph is only built again
+ *  after the bytes or flags of its function changed.
+ *
+ */
+
+#ifndef __CFGDB_HPP
+#define __CFGDB_HPP
+
+#include "cfg.hpp"
+
+// builds the graph of f, without the cache
+void cfg_discover(func_t *f, cfg_t &cfg);
+
+// the graph of f, from the cache if f didn't change
+void cfg_get(func_t *f, cfg_t &cfg);
+
+// the graphs of all functions, false if the user cancelled.
+// 'rebuilt' is the number of functions which weren't cached
+bool cfg_get_all(cfg_db_t &db, size_t *rebuilt);
+
+// forgets all cached graphs
+void cfg_drop_cache(void);
+
+#endif // __CFGDB_HPP
@@ -0,0 +1,411 @@
+/*
+ *	Graphtest 2 - structural signatures
+ *
+ *  Matching works in passes, each one only on the functions
+ *  left over by the ones before:
+ *
+ *  1.) exact hash, 2.) shape hash: both sides sorted by
+ *      the hash and merged. A hash which occurs equally
+ *      often on both sides is paired in address order,
+ *      which handles the many identical small functions.
+ *  3.) neighbours: a function between two matched ones is
+ *      compared with the functions between their partners
+ *      and takes the most similar one. Code rarely moves,
+ *      so this finds most patched functions. Ties are
+ *      ambiguous and left alone, conflicts go to the
+ *      better score.
+ *
+ *  Functions which were patched and moved elsewhere stay
+ *  unmatched: comparing them with every function of about
+ *  their size picked the wrong one far more often than the
+ *  right one, the numbers alone don't tell them apart.
+ *
+ *  Everything is a sort or bounded per function, 100000
+ *  against 100000 functions takes well below a second.
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef __IDP__
+#include <ida.hpp>
+#endif
+
+#include <algorithm>
+
+#include "cfgsig.hpp"
+
+#define MAX_CANDIDATES	128
+
+//--------------------------------------------------------------------------
+static inline uint32 mix(uint32 h, uint32 v)
+{
+	for ( int j=0; j<32; j+=8 )
+		h = (h ^ ((v >> j) & 0xFF)) * 16777619u;
+	return h;
+}
+
+void sig_builder_t::build(const cfg_view_t &g, cfg_sig_t &s)
+{
+	int n = (int)g.n;
+
+	memset(&s, 0, sizeof(s));
+	s.func = g.func;
+	s.blocks = (uint32)n;
+	s.edges = (uint32)g.nedges();
+	s.exact = s.shape = mix(mix(2166136261u, s.blocks), s.edges);
+	if ( n == 0 )
+		return;
+
+	indeg.assign(n, 0);
+	for ( int v=0; v<n; v++ )
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+			indeg[*p]++;
+
+	// breadth first from the entry, the level ends where it began
+	// to add the next one
+	order.clear();
+	num.assign(n, -1);
+	int entry = g.entry();
+	num[entry] = 0;
+	order.push_back(entry);
+	size_t level_end = 1;
+	s.levels = 1;
+	for ( size_t i=0; i<order.size(); i++ )
+	{
+		if ( i == level_end )
+		{
+			s.levels++;
+			level_end = order.size();
+		}
+		int v = order[i];
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+		{
+			if ( num[*p] < 0 )
+			{
+				num[*p] = (int)order.size();
+				order.push_back((int)*p);
+			}
+		}
+	}
+	// unreachable blocks last, in address order
+	for ( int v=0; v<n; v++ )
+	{
+		if ( num[v] < 0 )
+		{
+			num[v] = (int)order.size();
+			order.push_back(v);
+		}
+	}
+
+	for ( int i=0; i<n; i++ )
+	{
+		int v = order[i];
+		const cfg_block_t &b = g.blocks[v];
+		uint32 out = g.nsucc(v);
+
+		s.insns += b.ninsns;
+		s.calls += b.ncalls;
+		s.memops += b.nmemops;
+		s.hist[out < 3 ? out : 3]++;
+		s.hist[4 + (indeg[v] < 3 ? indeg[v] : 3)]++;
+
+		s.shape = mix(mix(s.shape, out), indeg[v]);
+		s.exact = mix(mix(mix(mix(mix(s.exact, out), indeg[v]), b.ninsns), b.ncalls), b.nmemops);
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+		{
+			if ( num[*p] <= i )
+				s.retreating++;
+			s.shape = mix(s.shape, num[*p]);
+			s.exact = mix(s.exact, num[*p]);
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+static void put32(unsigned char *p, uint32 v)
+{
+	p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8);
+	p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24);
+}
+
+static uint32 get32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+// a record: func, name, exact, shape, blocks, edges, insns, calls,
+// memops, levels, retreating (u32 each), hist (u16 each), reserved
+static void sig_put(unsigned char *p, const cfg_sig_t &s)
+{
+	const uint32 v[] = { s.func, s.name, s.exact, s.shape, s.blocks, s.edges,
+						 s.insns, s.calls, s.memops, s.levels, s.retreating };
+	memset(p, 0, CFGSIG_REC_SIZE);
+	for ( int i=0; i<11; i++ )
+		put32(p + i*4, v[i]);
+	for ( int i=0; i<CFGSIG_HIST; i++ )
+	{
+		p[44 + i*2] = (unsigned char)s.hist[i];
+		p[45 + i*2] = (unsigned char)(s.hist[i] >> 8);
+	}
+}
+
+static void sig_get(const unsigned char *p, cfg_sig_t &s)
+{
+	uint32 *v[] = { &s.name, &s.exact, &s.shape, &s.blocks, &s.edges,
+					&s.insns, &s.calls, &s.memops, &s.levels, &s.retreating };
+	s.func = get32(p);
+	for ( int i=0; i<10; i++ )
+		*v[i] = get32(p + 4 + i*4);
+	for ( int i=0; i<CFGSIG_HIST; i++ )
+		s.hist[i] = (unsigned short)(p[44 + i*2] | (p[45 + i*2] << 8));
+}
+
+bool cfg_index_t::save(const char *file) const
+{
+	unsigned char buf[CFGSIG_REC_SIZE];
+	FILE *fp = fopen(file, "wb");
+	bool ok;
+
+	if ( fp == NULL )
+		return false;
+	memset(buf, 0, CFGSIG_HDR_SIZE);
+	memcpy(buf, CFGSIG_MAGIC, 8);
+	put32(buf + 8, CFGSIG_VERSION);
+	put32(buf + 12, (uint32)sigs.size());
+	put32(buf + 16, (uint32)names.size());
+	ok = fwrite(buf, 1, CFGSIG_HDR_SIZE, fp) == CFGSIG_HDR_SIZE;
+	for ( size_t i=0; ok && i<sigs.size(); i++ )
+	{
+		sig_put(buf, sigs[i]);
+		ok = fwrite(buf, 1, CFGSIG_REC_SIZE, fp) == CFGSIG_REC_SIZE;
+	}
+	if ( ok && !names.empty() )
+		ok = fwrite(names.data(), 1, names.size(), fp) == names.size();
+	return fclose(fp) == 0 && ok;
+}
+
+bool cfg_index_t::load(const char *file)
+{
+	unsigned char buf[CFGSIG_REC_SIZE];
+	FILE *fp = fopen(file, "rb");
+	bool ok;
+
+	sigs.clear();
+	names.clear();
+	if ( fp == NULL )
+		return false;
+	ok = fread(buf, 1, CFGSIG_HDR_SIZE, fp) == CFGSIG_HDR_SIZE
+	  && memcmp(buf, CFGSIG_MAGIC, 8) == 0
+	  && get32(buf + 8) == CFGSIG_VERSION;
+	if ( ok )
+	{
+		uint32 count = get32(buf + 12);
+		uint32 size = get32(buf + 16);
+		sigs.resize(count);
+		for ( uint32 i=0; ok && i<count; i++ )
+		{
+			ok = fread(buf, 1, CFGSIG_REC_SIZE, fp) == CFGSIG_REC_SIZE;
+			sig_get(buf, sigs[i]);
+		}
+		names.resize(size);
+		if ( ok && size != 0 )
+			ok = fread(&names[0], 1, size, fp) == size;
+		// every name must be inside and terminated
+		if ( ok && size != 0 && names[size-1] != '\0' )
+			ok = false;
+		for ( uint32 i=0; ok && i<count; i++ )
+			ok = sigs[i].name < size || (size == 0 && sigs[i].name == 0);
+		if ( ok && size == 0 )
+			names.assign(1, '\0');
+	}
+	fclose(fp);
+	if ( !ok )
+	{
+		sigs.clear();
+		names.clear();
+	}
+	return ok;
+}
+
+//--------------------------------------------------------------------------
+// 1 - the relative distance of all numbers
+static float similarity(const cfg_sig_t &x, const cfg_sig_t &y)
+{
+	const uint32 a[] = { x.blocks, x.edges, x.insns, x.calls, x.memops, x.levels, x.retreating };
+	const uint32 b[] = { y.blocks, y.edges, y.insns, y.calls, y.memops, y.levels, y.retreating };
+	double diff = 0, sum = 0;
+
+	for ( int i=0; i<7; i++ )
+	{
+		diff += a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+		sum += a[i] + b[i];
+	}
+	for ( int i=0; i<CFGSIG_HIST; i++ )
+	{
+		diff += abs((int)x.hist[i] - (int)y.hist[i]);
+		sum += x.hist[i] + y.hist[i];
+	}
+	return sum == 0 ? 1.0f : (float)(1.0 - diff / sum);
+}
+
+struct by_key
+{
+	const std::vector<cfg_sig_t> &s;
+	uint32 cfg_sig_t::*key;
+
+	by_key(const std::vector<cfg_sig_t> &_s, uint32 cfg_sig_t::*_key) : s(_s), key(_key) {}
+	bool operator()(uint32 i, uint32 j) const
+	{
+		if ( s[i].*key != s[j].*key )
+			return s[i].*key < s[j].*key;
+		return s[i].func < s[j].func;
+	}
+};
+
+static void unmatched(const std::vector<bool> &done, std::vector<uint32> &v)
+{
+	v.clear();
+	for ( size_t i=0; i<done.size(); i++ )
+		if ( !done[i] )
+			v.push_back((uint32)i);
+}
+
+// pairs the functions with equal keys, see above
+static void match_key(const std::vector<cfg_sig_t> &a, const std::vector<cfg_sig_t> &b,
+					  uint32 cfg_sig_t::*key, char how,
+					  std::vector<bool> &done_a, std::vector<bool> &done_b,
+					  std::vector<sig_match_t> &pairs)
+{
+	std::vector<uint32> ia, ib;
+
+	unmatched(done_a, ia);
+	unmatched(done_b, ib);
+	std::sort(ia.begin(), ia.end(), by_key(a, key));
+	std::sort(ib.begin(), ib.end(), by_key(b, key));
+
+	size_t i = 0, j = 0;
+	while ( i < ia.size() && j < ib.size() )
+	{
+		uint32 ka = a[ia[i]].*key;
+		uint32 kb = b[ib[j]].*key;
+		if ( ka < kb )
+			i++;
+		else if ( kb < ka )
+			j++;
+		else
+		{
+			size_t ei = i, ej = j;
+			while ( ei < ia.size() && a[ia[ei]].*key == ka )
+				ei++;
+			while ( ej < ib.size() && b[ib[ej]].*key == ka )
+				ej++;
+			if ( ei - i == ej - j )
+			{
+				for ( ; i<ei; i++, j++ )
+				{
+					sig_match_t m = { ia[i], ib[j], how, 1.0f };
+					pairs.push_back(m);
+					done_a[ia[i]] = true;
+					done_b[ib[j]] = true;
+				}
+			}
+			i = ei;
+			j = ej;
+		}
+	}
+}
+
+static bool by_score(const sig_match_t &x, const sig_match_t &y)
+{
+	return x.score > y.score;
+}
+
+// adds the pairs of cand, best first, if both are still free
+static void resolve(std::vector<sig_match_t> &cand, std::vector<bool> &done_a,
+					std::vector<bool> &done_b, std::vector<sig_match_t> &pairs)
+{
+	std::stable_sort(cand.begin(), cand.end(), by_score);
+	for ( size_t i=0; i<cand.size(); i++ )
+	{
+		if ( done_a[cand[i].a] || done_b[cand[i].b] )
+			continue;
+		done_a[cand[i].a] = true;
+		done_b[cand[i].b] = true;
+		pairs.push_back(cand[i]);
+	}
+}
+
+// best and second best score of x against b[j], best_j is set if better
+static void consider(const cfg_sig_t &x, const cfg_sig_t &y, uint32 j,
+					 float &best, float &second, uint32 &best_j)
+{
+	float sc = similarity(x, y);
+	if ( sc > best )
+	{
+		second = best;
+		best = sc;
+		best_j = j;
+	}
+	else if ( sc > second )
+		second = sc;
+}
+
+static void neighbours(const std::vector<cfg_sig_t> &a, const std::vector<cfg_sig_t> &b,
+					   float min_score, std::vector<bool> &done_a, std::vector<bool> &done_b,
+					   std::vector<sig_match_t> &pairs)
+{
+	std::vector<int> partner(a.size(), -1);
+	std::vector<sig_match_t> cand;
+	std::vector<uint32> ib;
+
+	for ( size_t i=0; i<pairs.size(); i++ )
+		partner[pairs[i].a] = (int)pairs[i].b;
+	unmatched(done_b, ib);
+
+	// runs of unmatched functions between two matched ones
+	int prev_b = -1;
+	for ( size_t i=0; i<a.size(); )
+	{
+		if ( partner[i] >= 0 )
+		{
+			prev_b = partner[i++];
+			continue;
+		}
+		size_t end = i;
+		while ( end < a.size() && partner[end] < 0 )
+			end++;
+		int next_b = end < a.size() ? partner[end] : (int)b.size();
+		if ( prev_b < next_b )
+		{
+			for ( ; i<end; i++ )
+			{
+				float best = -1, second = -1;
+				uint32 best_j = 0;
+				size_t j = std::lower_bound(ib.begin(), ib.end(), (uint32)(prev_b + 1)) - ib.begin();
+				for ( int k=0; k<MAX_CANDIDATES && j<ib.size() && (int)ib[j]<next_b; k++, j++ )
+					consider(a[i], b[ib[j]], ib[j], best, second, best_j);
+				if ( best >= min_score && best > second )
+				{
+					sig_match_t m = { (uint32)i, best_j, MATCH_NEIGHBOUR, best };
+					cand.push_back(m);
+				}
+			}
+		}
+		i = end;
+	}
+	resolve(cand, done_a, done_b, pairs);
+}
+
+//--------------------------------------------------------------------------
+void sig_match(const std::vector<cfg_sig_t> &a, const std::vector<cfg_sig_t> &b,
+			   std::vector<sig_match_t> &pairs, float min_score)
+{
+	std::vector<bool> done_a(a.size(), false), done_b(b.size(), false);
+
+	pairs.clear();
+	match_key(a, b, &cfg_sig_t::exact, MATCH_EXACT, done_a, done_b, pairs);
+	match_key(a, b, &cfg_sig_t::shape, MATCH_SHAPE, done_a, done_b, pairs);
+	neighbours(a, b, min_score, done_a, done_b, pairs);
+}
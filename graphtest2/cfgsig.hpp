@@ -0,0 +1,103 @@
+/*
+ *	Graphtest 2 - structural signatures
+ *
+ *  A signature describes the shape of the flowgraph of a
+ *  function without its addresses, so the same function in
+ *  two versions of a binary gets the same one. The blocks
+ *  are numbered breadth first from the entry, successors
+ *  in address order, which makes the numbering canonical:
+ *
+ *    exact   hash of the degrees, the instruction counts
+ *            (all, calls, memory operands) and the edges
+ *            of every block in that numbering
+ *    shape   the same without the instruction counts, it
+ *            survives patches which don't touch the branches
+ *
+ *  plus a few numbers to compare functions which differ:
+ *  counts, a histogram of the degrees and the number of
+ *  levels and retreating edges of the breadth first search.
+ *
+ *  Index file (.cfgidx), all integers little endian:
+ *
+ *    header:  char magic[8]  "G2CFGIDX"
+ *             u32  version
+ *             u32  number of records
+ *             u32  size of the names
+ *             u32  reserved
+ *    records: CFGSIG_REC_SIZE bytes each, see sig_put()
+ *    names:   zero terminated, record.name is an offset
+ *
+ *  Doesn't need IDA, see cfg.hpp.
+ *
+ */
+
+#ifndef __CFGSIG_HPP
+#define __CFGSIG_HPP
+
+#include <string>
+
+#include "cfg.hpp"
+
+#define CFGSIG_MAGIC		"G2CFGIDX"
+#define CFGSIG_VERSION		1
+#define CFGSIG_HDR_SIZE		24
+#define CFGSIG_REC_SIZE		64
+
+#define CFGSIG_HIST			8		// out-degree 0..3+, in-degree 0..3+
+
+struct cfg_sig_t
+{
+	ea_t func;
+	uint32 name;			// offset into the names
+	uint32 exact;
+	uint32 shape;
+	uint32 blocks;
+	uint32 edges;
+	uint32 insns;
+	uint32 calls;
+	uint32 memops;
+	uint32 levels;			// of the breadth first search
+	uint32 retreating;		// edges to a block numbered before
+	unsigned short hist[CFGSIG_HIST];
+};
+
+struct cfg_index_t
+{
+	std::vector<cfg_sig_t> sigs;	// address order
+	std::string names;
+
+	const char *name(size_t i) const { return names.c_str() + sigs[i].name; }
+	bool save(const char *file) const;
+	bool load(const char *file);
+};
+
+// computes signatures, keeps its memory between functions
+class sig_builder_t
+{
+public:
+	void build(const cfg_view_t &g, cfg_sig_t &s);
+
+private:
+	std::vector<int> order, num, indeg;
+};
+
+//--------------------------------------------------------------------------
+// how a pair was found
+#define MATCH_EXACT		'E'		// same exact hash
+#define MATCH_SHAPE		'S'		// same shape hash
+#define MATCH_NEIGHBOUR	'N'		// the most similar one between matched neighbours
+
+struct sig_match_t
+{
+	uint32 a;				// indexes into the signatures
+	uint32 b;
+	char how;
+	float score;			// 1.0 = same numbers
+};
+
+// pairs the functions of a and b, every function at most once.
+// Both must be in address order, like cfg_index_t::sigs
+void sig_match(const std::vector<cfg_sig_t> &a, const std::vector<cfg_sig_t> &b,
+			   std::vector<sig_match_t> &pairs, float min_score = 0.75f);
+
+#endif // __CFGSIG_HPP
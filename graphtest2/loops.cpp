@@ -0,0 +1,341 @@
+/*
+ *	Graphtest 2 - dominators and loops
+ *
+ *  Dominators: Lengauer-Tarjan with path compression,
+ *  O(E log N), on the nodes renumbered in DFS preorder.
+ *  Nothing is recursive, obfuscated functions easily have
+ *  paths deeper than the stack.
+ *
+ *  Loops: the headers are visited in reverse preorder, so
+ *  inner loops come before the loops around them. The body
+ *  of a loop is collected backwards from the sources of its
+ *  back edges; inner loops found before are collapsed into
+ *  their header by a union-find, so every node is entered
+ *  about once (Tarjan / Havlak).
+ *
+ */
+
+#ifdef __IDP__
+#include <ida.hpp>
+#endif
+
+#include "loops.hpp"
+
+//--------------------------------------------------------------------------
+void loop_info_t::make_preds(const cfg_view_t &g)
+{
+	size_t n = g.n;
+
+	pred_off.assign(n + 1, 0);
+	for ( size_t v=0; v<n; v++ )
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+			pred_off[*p + 1]++;
+	for ( size_t v=0; v<n; v++ )
+		pred_off[v + 1] += pred_off[v];
+
+	pred.resize(pred_off[n]);
+	iter.assign(pred_off.begin(), pred_off.end() - 1);
+	for ( size_t v=0; v<n; v++ )
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+			pred[iter[*p]++] = (uint32)v;
+}
+
+//--------------------------------------------------------------------------
+// numbers the nodes reachable from entry in preorder
+void loop_info_t::dfs(const cfg_view_t &g, int entry)
+{
+	int n = (int)g.n;
+	int N = 0;
+
+	num.assign(n, -1);
+	vertex.resize(n);
+	parent.resize(n);
+	iter.resize(n);
+	stack.clear();
+
+	num[entry] = N;
+	vertex[N] = entry;
+	parent[N] = -1;
+	N++;
+	iter[entry] = g.succ_off[entry];
+	stack.push_back(entry);
+	while ( !stack.empty() )
+	{
+		int v = stack.back();
+		if ( (uint32)iter[v] < g.succ_off[v+1] )
+		{
+			int w = (int)g.succ[iter[v]++];
+			if ( num[w] < 0 )
+			{
+				num[w] = N;
+				vertex[N] = w;
+				parent[N] = num[v];
+				N++;
+				iter[w] = g.succ_off[w];
+				stack.push_back(w);
+			}
+		}
+		else
+			stack.pop_back();
+	}
+	nreachable = N;
+}
+
+//--------------------------------------------------------------------------
+int loop_info_t::eval(int v)
+{
+	if ( ancestor[v] < 0 )
+		return v;
+
+	// compress the path to the root of v's tree in the forest
+	stack.clear();
+	for ( int x=v; ancestor[ancestor[x]] >= 0; x=ancestor[x] )
+		stack.push_back(x);
+	while ( !stack.empty() )
+	{
+		int x = stack.back();
+		int a = ancestor[x];
+		stack.pop_back();
+		if ( semi[label[a]] < semi[label[x]] )
+			label[x] = label[a];
+		ancestor[x] = ancestor[a];
+	}
+	return label[v];
+}
+
+void loop_info_t::dominators(void)
+{
+	int N = (int)nreachable;
+
+	semi.resize(N);
+	label.resize(N);
+	ancestor.assign(N, -1);
+	bucket_head.assign(N, -1);
+	bucket_next.resize(N);
+	dom.assign(N, -1);
+	for ( int i=0; i<N; i++ )
+		semi[i] = label[i] = i;
+
+	for ( int w=N-1; w>0; w-- )
+	{
+		int node = vertex[w];
+		for ( uint32 k=pred_off[node]; k<pred_off[node+1]; k++ )
+		{
+			int v = num[pred[k]];
+			if ( v < 0 )
+				continue;
+			int u = eval(v);
+			if ( semi[u] < semi[w] )
+				semi[w] = semi[u];
+		}
+		bucket_next[w] = bucket_head[semi[w]];
+		bucket_head[semi[w]] = w;
+		ancestor[w] = parent[w];
+
+		int p = parent[w];
+		for ( int v=bucket_head[p]; v >= 0; v=bucket_next[v] )
+		{
+			int u = eval(v);
+			dom[v] = semi[u] < semi[v] ? u : p;
+		}
+		bucket_head[p] = -1;
+	}
+	for ( int w=1; w<N; w++ )
+	{
+		if ( dom[w] != semi[w] )
+			dom[w] = dom[dom[w]];
+	}
+
+	idom.assign(num.size(), -1);
+	for ( int w=1; w<N; w++ )
+		idom[vertex[w]] = vertex[dom[w]];
+}
+
+//--------------------------------------------------------------------------
+// pre/post numbers of the dominator tree, for dominates()
+void loop_info_t::number_dom_tree(int entry)
+{
+	int N = (int)nreachable;
+	int counter = 0;
+
+	// children in CSR form, in preorder numbers
+	child_off.assign(N + 1, 0);
+	for ( int w=1; w<N; w++ )
+		child_off[dom[w] + 1]++;
+	for ( int w=0; w<N; w++ )
+		child_off[w + 1] += child_off[w];
+	child.resize(N > 0 ? N - 1 : 0);
+	iter.assign(child_off.begin(), child_off.end() - 1);
+	for ( int w=1; w<N; w++ )
+		child[iter[dom[w]]++] = w;
+
+	pre.assign(num.size(), -1);
+	post.assign(num.size(), -1);
+	iter.assign(child_off.begin(), child_off.end() - 1);
+	stack.clear();
+	stack.push_back(0);
+	pre[entry] = counter++;
+	while ( !stack.empty() )
+	{
+		int v = stack.back();
+		if ( iter[v] < child_off[v+1] )
+		{
+			int w = child[iter[v]++];
+			pre[vertex[w]] = counter++;
+			stack.push_back(w);
+		}
+		else
+		{
+			post[vertex[v]] = counter++;
+			stack.pop_back();
+		}
+	}
+}
+
+//--------------------------------------------------------------------------
+int loop_info_t::find(int x)
+{
+	int r = x;
+	while ( rep[r] != r )
+		r = rep[r];
+	while ( rep[x] != r )
+	{
+		int next = rep[x];
+		rep[x] = r;
+		x = next;
+	}
+	return r;
+}
+
+void loop_info_t::find_loops(const cfg_view_t &g)
+{
+	int n = (int)g.n;
+	int N = (int)nreachable;
+
+	header.assign(n, -1);
+	loop_parent.assign(n, -1);
+	depth.assign(n, 0);
+	mark.assign(n, -1);
+	rep.resize(n);
+	for ( int v=0; v<n; v++ )
+		rep[v] = v;
+
+	for ( int i=N-1; i>=0; i-- )
+	{
+		int h = vertex[i];
+		bool is_loop = false;
+
+		work.clear();
+		for ( uint32 k=pred_off[h]; k<pred_off[h+1]; k++ )
+		{
+			int p = (int)pred[k];
+			if ( num[p] < 0 || !dominates(h, p) )
+				continue;
+			is_loop = true;
+			if ( p != h )
+				work.push_back(find(p));
+		}
+		if ( !is_loop )
+			continue;
+
+		nloops++;
+		header[h] = h;
+		mark[h] = h;
+		while ( !work.empty() )
+		{
+			int x = work.back();
+			work.pop_back();
+			if ( x == h || mark[x] == h )
+				continue;
+			mark[x] = h;
+			if ( header[x] == x )
+				loop_parent[x] = h;		// an inner loop, collapsed into x
+			else
+				header[x] = h;
+			rep[x] = h;
+
+			for ( uint32 k=pred_off[x]; k<pred_off[x+1]; k++ )
+			{
+				int y = (int)pred[k];
+				if ( num[y] < 0 )
+					continue;
+				y = find(y);
+				// entries from outside the loop make it irreducible,
+				// they don't belong to it
+				if ( y != h && mark[y] != h && dominates(h, y) )
+					work.push_back(y);
+			}
+		}
+	}
+
+	// outer headers come first in preorder
+	for ( int i=0; i<N; i++ )
+	{
+		int v = vertex[i];
+		if ( header[v] == v )
+		{
+			depth[v] = loop_parent[v] >= 0 ? depth[loop_parent[v]] + 1 : 1;
+			if ( depth[v] > max_depth )
+				max_depth = depth[v];
+		}
+	}
+	for ( int v=0; v<n; v++ )
+	{
+		if ( header[v] >= 0 && header[v] != v )
+			depth[v] = depth[header[v]];
+	}
+}
+
+//--------------------------------------------------------------------------
+void loop_info_t::analyse(const cfg_view_t &g, int entry)
+{
+	nloops = 0;
+	max_depth = 0;
+	nirreducible = 0;
+	nreachable = 0;
+	edge_kind.assign(g.nedges(), EDGE_NORMAL);
+	if ( g.n == 0 )
+	{
+		idom.clear();
+		header.clear();
+		loop_parent.clear();
+		depth.clear();
+		pre.clear();
+		post.clear();
+		return;
+	}
+
+	make_preds(g);
+	dfs(g, entry);
+	dominators();
+	number_dom_tree(entry);
+
+	// back edges need dominators, irreducible ones the DFS tree:
+	// w is an ancestor of v if v was entered while w was open
+	last.assign(nreachable, 0);
+	for ( int i=(int)nreachable-1; i>=0; i-- )
+	{
+		if ( last[i] < i )
+			last[i] = i;
+		if ( parent[i] >= 0 && last[parent[i]] < last[i] )
+			last[parent[i]] = last[i];
+	}
+	for ( size_t v=0; v<g.n; v++ )
+	{
+		if ( num[v] < 0 )
+			continue;
+		for ( uint32 k=g.succ_off[v]; k<g.succ_off[v+1]; k++ )
+		{
+			int w = (int)g.succ[k];
+			if ( dominates(w, (int)v) )
+				edge_kind[k - g.succ_off[0]] = EDGE_BACK;
+			else if ( num[w] <= num[v] && num[v] <= last[num[w]] )
+			{
+				edge_kind[k - g.succ_off[0]] = EDGE_IRREDUCIBLE;
+				nirreducible++;
+			}
+		}
+	}
+
+	find_loops(g);
+}
@@ -0,0 +1,75 @@
+/*
+ *	Graphtest 2 - dominators and loops
+ *
+ *  Dominator tree (Lengauer-Tarjan) and loop nesting forest
+ *  of a control flow graph. A back edge is an edge whose
+ *  target dominates its source, the target is the header
+ *  of a loop. Retreating edges into a node which doesn't
+ *  dominate their source belong to irreducible regions,
+ *  they are counted but don't make loops.
+ *
+ *  All arrays belong to the object and keep their memory,
+ *  so analysing many functions with one loop_info_t costs
+ *  no allocations once it has seen the largest one.
+ *
+ *  Doesn't need IDA, see cfg.hpp.
+ *
+ */
+
+#ifndef __LOOPS_HPP
+#define __LOOPS_HPP
+
+#include "cfg.hpp"
+
+// kinds of edges, indexed like cfg_view_t::succ (minus succ_off[0])
+#define EDGE_NORMAL			0
+#define EDGE_BACK			1	// target dominates the source
+#define EDGE_IRREDUCIBLE	2	// retreating, but not a back edge
+
+class loop_info_t
+{
+public:
+	// per node, -1 = none
+	std::vector<int> idom;			// the entry and unreachable nodes have none
+	std::vector<int> header;		// innermost loop, a header is its own
+	std::vector<int> loop_parent;	// per header: the enclosing loop
+	std::vector<int> depth;			// number of loops around the node
+
+	std::vector<unsigned char> edge_kind;
+
+	size_t nloops;
+	int max_depth;
+	size_t nirreducible;
+	size_t nreachable;
+
+	void analyse(const cfg_view_t &g, int entry = 0);
+
+	bool is_header(int n) const { return header[n] == n; }
+	bool is_reachable(int n) const { return pre[n] >= 0; }
+	bool dominates(int a, int b) const
+	{
+		return pre[a] >= 0 && pre[b] >= 0 && pre[a] <= pre[b] && post[b] <= post[a];
+	}
+
+private:
+	// predecessors in CSR form
+	std::vector<uint32> pred_off, pred;
+	// depth first search, nodes renumbered in preorder
+	std::vector<int> num, vertex, parent, last, stack, iter;
+	// Lengauer-Tarjan, in preorder numbers
+	std::vector<int> semi, label, ancestor, bucket_head, bucket_next, dom;
+	// dominator tree numbering for dominates()
+	std::vector<int> pre, post, child_off, child;
+	// loops
+	std::vector<int> rep, work, mark;
+
+	void make_preds(const cfg_view_t &g);
+	void dfs(const cfg_view_t &g, int entry);
+	int eval(int v);
+	void dominators(void);
+	void number_dom_tree(int entry);
+	int find(int x);
+	void find_loops(const cfg_view_t &g);
+};
+
+#endif // __LOOPS_HPP
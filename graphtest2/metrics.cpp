@@ -0,0 +1,147 @@
+/*
+ *	Graphtest 2 - function metrics
+ *
+ *  The workers take chunks of functions from a shared
+ *  counter, small functions are much more common than big
+ *  ones and would leave fixed ranges unbalanced. Each one
+ *  has its own loop_info_t, so after the first few
+ *  functions nothing is allocated any more, and writes
+ *  its results straight into their place in the output.
+ *
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#ifdef __IDP__
+#include <ida.hpp>
+#endif
+
+#include "loops.hpp"
+#include "metrics.hpp"
+
+#define CHUNK		64		// functions taken at once
+#define MAX_THREADS	64
+
+struct work_t
+{
+	const cfg_db_t *db;
+	func_metrics_t *out;
+	size_t qty;
+	volatile long next;
+};
+
+//--------------------------------------------------------------------------
+static void measure(const cfg_view_t &g, loop_info_t &li, func_metrics_t &m)
+{
+	m.func = g.func;
+	m.blocks = (uint32)g.n;
+	m.edges = (uint32)g.nedges();
+	m.cyclomatic = g.n != 0 ? (int)m.edges - (int)m.blocks + 2 : 0;
+	m.insns = 0;
+	for ( size_t i=0; i<g.n; i++ )
+		m.insns += g.blocks[i].ninsns;
+
+	li.analyse(g, g.entry());
+	m.loops = (uint32)li.nloops;
+	m.max_depth = (uint32)li.max_depth;
+	m.irreducible = (uint32)li.nirreducible;
+}
+
+static void work(work_t *w)
+{
+	loop_info_t li;
+
+	for ( ;; )
+	{
+#ifdef _WIN32
+		size_t i = (size_t)InterlockedExchangeAdd((volatile LONG *)&w->next, CHUNK);
+#else
+		size_t i = (size_t)__sync_fetch_and_add(&w->next, CHUNK);
+#endif
+		if ( i >= w->qty )
+			break;
+		size_t end = i + CHUNK < w->qty ? i + CHUNK : w->qty;
+		for ( ; i<end; i++ )
+			measure(w->db->view(i), li, w->out[i]);
+	}
+}
+
+#ifdef _WIN32
+static DWORD WINAPI worker(void *p)
+{
+	work((work_t *)p);
+	return 0;
+}
+#else
+static void *worker(void *p)
+{
+	work((work_t *)p);
+	return NULL;
+}
+#endif
+
+//--------------------------------------------------------------------------
+int metrics_cpus(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO si;
+	GetSystemInfo(&si);
+	return (int)si.dwNumberOfProcessors;
+#else
+	return (int)sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+void metrics_compute(const cfg_db_t &db, std::vector<func_metrics_t> &out, int nthreads)
+{
+	work_t w;
+
+	out.resize(db.size());
+	if ( db.size() == 0 )
+		return;
+	w.db = &db;
+	w.out = &out[0];
+	w.qty = db.size();
+	w.next = 0;
+
+	if ( nthreads <= 0 )
+		nthreads = metrics_cpus();
+	if ( nthreads > MAX_THREADS )
+		nthreads = MAX_THREADS;
+	if ( (size_t)nthreads > (db.size() + CHUNK - 1) / CHUNK )
+		nthreads = (int)((db.size() + CHUNK - 1) / CHUNK);
+
+	// the calling thread is a worker as well
+#ifdef _WIN32
+	HANDLE threads[MAX_THREADS];
+	DWORD id;
+	int n = 0;
+	for ( int i=1; i<nthreads; i++ )
+	{
+		threads[n] = CreateThread(NULL, 0, worker, &w, 0, &id);
+		if ( threads[n] != NULL )
+			n++;
+	}
+	work(&w);
+	if ( n != 0 )
+		WaitForMultipleObjects(n, threads, TRUE, INFINITE);
+	for ( int i=0; i<n; i++ )
+		CloseHandle(threads[i]);
+#else
+	pthread_t threads[MAX_THREADS];
+	int n = 0;
+	for ( int i=1; i<nthreads; i++ )
+	{
+		if ( pthread_create(&threads[n], NULL, worker, &w) == 0 )
+			n++;
+	}
+	work(&w);
+	for ( int i=0; i<n; i++ )
+		pthread_join(threads[i], NULL);
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+ *	Graphtest 2 - function metrics
+ *
+ *  Size and complexity of every function of a cfg_db_t,
+ *  for ranking functions for review. The graphs are built
+ *  on the main thread (cfg_get_all), the analysis of the
+ *  graphs only reads the cfg_db_t and is spread over
+ *  threads.
+ *
+ *  Doesn't need IDA, see cfg.hpp.
+ *
+ */
+
+#ifndef __METRICS_HPP
+#define __METRICS_HPP
+
+#include "cfg.hpp"
+
+struct func_metrics_t
+{
+	ea_t func;
+	uint32 blocks;
+	uint32 edges;
+	int cyclomatic;		// edges - blocks + 2
+	uint32 loops;
+	uint32 max_depth;	// of loop nesting
+	uint32 irreducible;	// edges into irreducible loops
+	uint32 insns;
+};
+
+// metrics of all functions of db, out[i] belongs to db.funcs[i].
+// nthreads <= 0 uses one thread per processor
+void metrics_compute(const cfg_db_t &db, std::vector<func_metrics_t> &out, int nthreads = 0);
+
+// the number of processors
+int metrics_cpus(void);
+
+#endif // __METRICS_HPP
@@ -0,0 +1,264 @@
+/*
+ *	cfgmatch - pairs the functions of two signature indexes
+ *
+ *  Reads two .cfgidx files written by the flowgraph plugin
+ *  (argument 5) and matches them like argument 6 does, see
+ *  cfgsig.cpp. With -bench it makes a synthetic database,
+ *  a patched copy of it (changed instructions, changed
+ *  branches, functions added, removed and moved elsewhere)
+ *  and reports the time and how many pairs are right.
+ *
+ *  Build (Linux):
+ *    g++ -O2 -o cfgmatch cfgmatch.cpp ../cfgsig.cpp
+ *
+ *  Usage:
+ *    cfgmatch old.cfgidx new.cfgidx [matches.csv]
+ *    cfgmatch -bench [functions]      (default 100000)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "../cfgsig.hpp"
+
+//--------------------------------------------------------------------------
+static unsigned int rnd_state = 4711;
+
+static unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// a function of n blocks with branches and loops, from seed
+static void make_cfg(cfg_t &cfg, ea_t ea, size_t n, unsigned int seed)
+{
+	std::vector<uint32> t;
+	unsigned int saved = rnd_state;
+
+	rnd_state = seed;
+	cfg.func = ea;
+	cfg.clear();
+	for ( size_t i=0; i<n; i++ )
+	{
+		cfg_block_t b = { (ea_t)(ea + i*16), (ea_t)(ea + i*16 + 16), 1 + rnd(8), rnd(2), rnd(3) };
+		cfg.blocks.push_back(b);
+
+		t.clear();
+		if ( i+1 < n )
+			t.push_back((uint32)(i+1));
+		if ( rnd(2) == 0 )
+		{
+			int to = (int)i + (int)rnd(24) - 8;
+			if ( to >= 0 && to < (int)n )
+				t.push_back((uint32)to);
+		}
+		std::sort(t.begin(), t.end());
+		t.erase(std::unique(t.begin(), t.end()), t.end());
+		cfg.succ.insert(cfg.succ.end(), t.begin(), t.end());
+		cfg.succ_off.push_back((uint32)cfg.succ.size());
+	}
+	rnd_state = saved;
+}
+
+// a patch: more instructions in one block, or one more branch
+static void patch(cfg_t &cfg, bool branch = false)
+{
+	size_t v = rnd((unsigned int)cfg.blocks.size());
+
+	if ( !branch && (rnd(4) != 0 || cfg.blocks.size() < 3) )
+	{
+		cfg.blocks[v].ninsns += 1 + rnd(3);
+		return;
+	}
+	// insert a successor into the list of v
+	uint32 to = rnd((unsigned int)cfg.blocks.size());
+	std::vector<uint32> succ, off = cfg.succ_off;
+	for ( size_t i=0; i<cfg.blocks.size(); i++ )
+	{
+		size_t start = succ.size();
+		succ.insert(succ.end(), cfg.succ.begin() + off[i], cfg.succ.begin() + off[i+1]);
+		if ( i == v )
+		{
+			succ.push_back(to);
+			std::sort(succ.begin() + start, succ.end());
+			succ.erase(std::unique(succ.begin() + start, succ.end()), succ.end());
+		}
+		cfg.succ_off[i+1] = (uint32)succ.size();
+	}
+	cfg.succ = succ;
+}
+
+static int bench(size_t qty)
+{
+	std::vector<cfg_sig_t> a, b;
+	std::vector<uint32> id_b;		// b's function -> a's, or -1 for new ones
+	std::vector<sig_match_t> pairs;
+	sig_builder_t sb;
+	cfg_sig_t s;
+	cfg_t cfg;
+	ea_t ea_a = 0x401000, ea_b = 0x401000;
+	size_t patched = 0;
+	std::vector<unsigned int> moved;	// old index, size, seed
+
+	for ( size_t i=0; i<qty; i++ )
+	{
+		// sizes fall off like in real code
+		size_t n = 1 + rnd(16);
+		if ( rnd(20) == 0 )
+			n = 1 + rnd(400);
+		if ( i == 0 )
+			n = 12;
+		unsigned int seed = rnd(0x7FFFFFFF);
+
+		make_cfg(cfg, ea_a, n, seed);
+		sb.build(cfg.view(), s);
+		a.push_back(s);
+		ea_a += (ea_t)(n * 16);
+
+		// removed in the new version
+		if ( rnd(100) == 0 && i > 0 )
+			continue;
+		// moved to the end of the new version
+		if ( rnd(200) == 0 && i > 0 )
+		{
+			moved.push_back((unsigned int)i);
+			moved.push_back((unsigned int)n);
+			moved.push_back(seed);
+			continue;
+		}
+		// a new function in front of it
+		if ( rnd(100) == 0 )
+		{
+			size_t m = 1 + rnd(40);
+			make_cfg(cfg, ea_b, m, rnd(0x7FFFFFFF));
+			sb.build(cfg.view(), s);
+			b.push_back(s);
+			id_b.push_back((uint32)-1);
+			ea_b += (ea_t)(m * 16);
+		}
+		// the first one always gets a new branch, so only the
+		// neighbours find it, and nothing matched comes before it
+		make_cfg(cfg, ea_b, n, seed);
+		if ( rnd(10) == 0 || i == 0 )
+		{
+			patch(cfg, i == 0);
+			patched++;
+		}
+		sb.build(cfg.view(), s);
+		b.push_back(s);
+		id_b.push_back((uint32)i);
+		ea_b += (ea_t)(n * 16 + (rnd(8) == 0 ? 16 : 0));
+	}
+	// all of them patched, the matcher leaves them alone
+	for ( size_t i=0; i<moved.size(); i+=3 )
+	{
+		make_cfg(cfg, ea_b, moved[i+1], moved[i+2]);
+		patch(cfg);
+		patched++;
+		sb.build(cfg.view(), s);
+		b.push_back(s);
+		id_b.push_back(moved[i]);
+		ea_b += (ea_t)(moved[i+1] * 16);
+	}
+	printf("%u old and %u new functions, %u patched, %u moved\n",
+		(unsigned)a.size(), (unsigned)b.size(), (unsigned)patched, (unsigned)moved.size() / 3);
+
+	double t = now_ms();
+	sig_match(a, b, pairs);
+	t = now_ms() - t;
+
+	size_t right[3] = { 0, 0, 0 }, total[3] = { 0, 0, 0 };
+	bool first = false;
+	const char how[] = { MATCH_EXACT, MATCH_SHAPE, MATCH_NEIGHBOUR, 0 };
+	for ( size_t i=0; i<pairs.size(); i++ )
+	{
+		int k = (int)(strchr(how, pairs[i].how) - how);
+		total[k]++;
+		if ( id_b[pairs[i].b] == pairs[i].a )
+		{
+			right[k]++;
+			if ( pairs[i].a == 0 )
+				first = true;
+		}
+	}
+	printf("matched %u in %.1f ms\n", (unsigned)pairs.size(), t);
+	printf("  exact   %8u, %8u right\n", (unsigned)total[0], (unsigned)right[0]);
+	printf("  shape   %8u, %8u right\n", (unsigned)total[1], (unsigned)right[1]);
+	printf("  nearby  %8u, %8u right\n", (unsigned)total[2], (unsigned)right[2]);
+	printf("  first function %s\n", first ? "matched" : "not matched");
+	return 0;
+}
+
+//--------------------------------------------------------------------------
+// CSV field, quoted like the plugin does it
+static void write_string(FILE *fp, const char *s)
+{
+	fputc('"', fp);
+	for ( ; *s != '\0'; s++ )
+	{
+		if ( *s == '"' )
+			fputc('"', fp);
+		fputc(*s, fp);
+	}
+	fputc('"', fp);
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	cfg_index_t a, b;
+	std::vector<sig_match_t> pairs;
+
+	if ( argc >= 2 && strcmp(argv[1], "-bench") == 0 )
+		return bench(argc > 2 ? (size_t)atoi(argv[2]) : 100000);
+	if ( argc < 3 )
+	{
+		fprintf(stderr, "usage: cfgmatch old.cfgidx new.cfgidx [matches.csv]\n"
+						"       cfgmatch -bench [functions]\n");
+		return 1;
+	}
+	if ( !a.load(argv[1]) || !b.load(argv[2]) )
+	{
+		fprintf(stderr, "cfgmatch: can't read %s\n", a.sigs.empty() ? argv[1] : argv[2]);
+		return 1;
+	}
+
+	double t = now_ms();
+	sig_match(a.sigs, b.sigs, pairs);
+	t = now_ms() - t;
+
+	FILE *fp = argc > 3 ? fopen(argv[3], "w") : stdout;
+	if ( fp == NULL )
+	{
+		fprintf(stderr, "cfgmatch: can't write %s\n", argv[3]);
+		return 1;
+	}
+	fprintf(fp, "old,old_name,new,new_name,how,score\n");
+	for ( size_t i=0; i<pairs.size(); i++ )
+	{
+		const sig_match_t &m = pairs[i];
+		fprintf(fp, "%08X,", a.sigs[m.a].func);
+		write_string(fp, a.name(m.a));
+		fprintf(fp, ",%08X,", b.sigs[m.b].func);
+		write_string(fp, b.name(m.b));
+		fprintf(fp, ",%c,%.3f\n", m.how, m.score);
+	}
+	if ( fp != stdout )
+		fclose(fp);
+	fprintf(stderr, "%u of %u / %u functions matched in %.1f ms\n",
+		(unsigned)pairs.size(), (unsigned)a.sigs.size(), (unsigned)b.sigs.size(), t);
+	return 0;
+}
@@ -0,0 +1,173 @@
+/*
+ *	edgebench - edge construction of the custom flowgraph
+ *
+ *  Builds the edges of synthetic control flow graphs the
+ *  way grcode_user_refresh used to (a walk over all blocks
+ *  for every xref) and with the block index (blockidx.hpp),
+ *  and prints both times.
+ *
+ *  Every block falls through to the next one most of the
+ *  time, has a conditional branch half of the time and a
+ *  switch now and then; some xrefs point to data.
+ *
+ *  Build (Linux):
+ *    g++ -O2 -o edgebench edgebench.cpp
+ *
+ *  Usage:
+ *    edgebench [blocks ...]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <map>
+#include <vector>
+
+typedef unsigned int ea_t;
+typedef unsigned int asize_t;
+
+#include "../blockidx.hpp"
+
+typedef std::map<ea_t, asize_t> basic_blocks_t;
+
+struct cfg_t
+{
+	basic_blocks_t bbs;
+	std::vector< std::vector<ea_t> > xrefs;	// per block, in address order
+};
+
+//--------------------------------------------------------------------------
+static unsigned int rnd_state = 12345;
+
+static unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static void make_cfg(cfg_t &cfg, size_t n)
+{
+	std::vector<ea_t> starts(n);
+	ea_t ea = 0x401000;
+	size_t i;
+
+	cfg.bbs.clear();
+	for ( i=0; i<n; i++ )
+	{
+		asize_t size = 2 + rnd(40);
+		starts[i] = ea;
+		cfg.bbs[ea] = size;
+		ea += size;
+	}
+
+	cfg.xrefs.assign(n, std::vector<ea_t>());
+	for ( i=0; i<n; i++ )
+	{
+		std::vector<ea_t> &x = cfg.xrefs[i];
+		if ( i+1 < n && rnd(10) < 8 )
+			x.push_back(starts[i+1]);
+		if ( rnd(2) == 0 )
+			x.push_back(starts[rnd((unsigned int)n)]);
+		if ( rnd(100) == 0 )
+		{
+			for ( int k=0; k<16; k++ )
+				x.push_back(starts[rnd((unsigned int)n)]);
+		}
+		if ( rnd(10) < 3 )
+			x.push_back(0x800000 + rnd(0x10000));
+	}
+}
+
+//--------------------------------------------------------------------------
+// the old loop of grcode_user_refresh
+static size_t edges_scan(const cfg_t &cfg)
+{
+	size_t edges = 0;
+	int j = 0;
+	for ( basic_blocks_t::const_iterator p=cfg.bbs.begin(); p != cfg.bbs.end(); ++p )
+	{
+		const std::vector<ea_t> &x = cfg.xrefs[j];
+		for ( size_t i=0; i<x.size(); i++ )
+		{
+			for ( basic_blocks_t::const_iterator p2=cfg.bbs.begin(); p2 != cfg.bbs.end(); ++p2 )
+			{
+				if ( x[i] == p2->first )
+					edges++;
+			}
+		}
+		j++;
+	}
+	return edges;
+}
+
+// the new one, index built from scratch as on every refresh
+static size_t edges_index(const cfg_t &cfg)
+{
+	block_index_t idx;
+	size_t edges = 0;
+
+	idx.reserve(cfg.bbs.size());
+	for ( basic_blocks_t::const_iterator p=cfg.bbs.begin(); p != cfg.bbs.end(); ++p )
+		idx.add(p->first);
+
+	for ( size_t j=0; j<cfg.xrefs.size(); j++ )
+	{
+		const std::vector<ea_t> &x = cfg.xrefs[j];
+		for ( size_t i=0; i<x.size(); i++ )
+		{
+			if ( idx.find(x[i]) >= 0 )
+				edges++;
+		}
+	}
+	return edges;
+}
+
+static double ms_since(clock_t start)
+{
+	return (clock() - start) * 1000.0 / CLOCKS_PER_SEC;
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	static const size_t defaults[] = { 100, 500, 1000, 5000, 10000 };
+	std::vector<size_t> sizes;
+	cfg_t cfg;
+
+	for ( int i=1; i<argc; i++ )
+		sizes.push_back((size_t)atoi(argv[i]));
+	if ( sizes.empty() )
+		sizes.assign(defaults, defaults + sizeof(defaults)/sizeof(defaults[0]));
+
+	printf("%8s %8s %12s %12s %10s\n", "blocks", "edges", "scan ms", "index ms", "speedup");
+	for ( size_t i=0; i<sizes.size(); i++ )
+	{
+		make_cfg(cfg, sizes[i]);
+
+		// repeat the fast one to get a measurable time
+		int reps = 0;
+		size_t e2 = 0;
+		clock_t t = clock();
+		do
+		{
+			e2 = edges_index(cfg);
+			reps++;
+		} while ( ms_since(t) < 100 );
+		double t2 = ms_since(t) / reps;
+
+		t = clock();
+		size_t e1 = edges_scan(cfg);
+		double t1 = ms_since(t);
+
+		if ( e1 != e2 )
+		{
+			fprintf(stderr, "edgebench: edge counts differ (%u != %u)\n", (unsigned)e1, (unsigned)e2);
+			return 1;
+		}
+		printf("%8u %8u %12.2f %12.4f %9.0fx\n",
+			(unsigned)sizes[i], (unsigned)e1, t1, t2, t2 > 0 ? t1 / t2 : 0.0);
+	}
+	return 0;
+}
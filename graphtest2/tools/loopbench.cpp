@@ -0,0 +1,177 @@
+/*
+ *	loopbench - dominators and loops on synthetic graphs
+ *
+ *  Checks loop_info_t (loops.cpp) against the iterative
+ *  dataflow dominators on small random graphs, then times
+ *  it on large "obfuscated" ones: a chain of blocks with
+ *  random forward and backward jumps and nested loops.
+ *
+ *  Build (Linux):
+ *    g++ -O2 -o loopbench loopbench.cpp ../loops.cpp
+ *
+ *  Usage:
+ *    loopbench [blocks ...]
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include <algorithm>
+
+#include "../loops.hpp"
+
+//--------------------------------------------------------------------------
+static unsigned int rnd_state = 4711;
+
+static unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+// n blocks, falls through mostly, jumps anywhere now and then.
+// With 'chain' every block falls through, so all of them can be
+// reached from the entry.
+static void make_cfg(cfg_t &cfg, size_t n, unsigned int jumps, bool chain)
+{
+	std::vector<uint32> t;
+
+	cfg.func = 0x401000;
+	cfg.clear();
+	for ( size_t i=0; i<n; i++ )
+	{
+		cfg_block_t b = { (ea_t)(0x401000 + i*16), (ea_t)(0x401010 + i*16), 4, 0, 1 };
+		cfg.blocks.push_back(b);
+
+		t.clear();
+		if ( i+1 < n && (chain || rnd(10) < 8) )
+			t.push_back((uint32)(i+1));
+		for ( unsigned int k=rnd(jumps + 1); k>0; k-- )
+		{
+			// mostly short jumps, loops back now and then
+			int d = (int)rnd(32) - 12;
+			if ( rnd(50) == 0 )
+				d = (int)rnd((unsigned int)n) - (int)i;
+			int to = (int)i + d;
+			if ( to >= 0 && to < (int)n )
+				t.push_back((uint32)to);
+		}
+		std::sort(t.begin(), t.end());
+		t.erase(std::unique(t.begin(), t.end()), t.end());
+		cfg.succ.insert(cfg.succ.end(), t.begin(), t.end());
+		cfg.succ_off.push_back((uint32)cfg.succ.size());
+	}
+}
+
+//--------------------------------------------------------------------------
+// dominator sets by iteration, small graphs only
+static bool check(const cfg_t &cfg, const loop_info_t &li)
+{
+	cfg_view_t g = cfg.view();
+	size_t n = g.n;
+	std::vector< std::vector<bool> > dom(n, std::vector<bool>(n, true));
+	std::vector<bool> reach(n, false);
+	std::vector<int> st(1, 0);
+
+	reach[0] = true;
+	while ( !st.empty() )
+	{
+		int v = st.back();
+		st.pop_back();
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+			if ( !reach[*p] )
+			{
+				reach[*p] = true;
+				st.push_back(*p);
+			}
+	}
+	dom[0].assign(n, false);
+	dom[0][0] = true;
+
+	bool changed = true;
+	while ( changed )
+	{
+		changed = false;
+		for ( size_t v=1; v<n; v++ )
+		{
+			if ( !reach[v] )
+				continue;
+			std::vector<bool> d(n, true);
+			for ( size_t u=0; u<n; u++ )
+				for ( const uint32 *p=g.succ_begin(u); p != g.succ_end(u); p++ )
+					if ( *p == v && reach[u] )
+						for ( size_t k=0; k<n; k++ )
+							d[k] = d[k] && dom[u][k];
+			d[v] = true;
+			if ( d != dom[v] )
+			{
+				dom[v] = d;
+				changed = true;
+			}
+		}
+	}
+
+	for ( size_t a=0; a<n; a++ )
+		for ( size_t b=0; b<n; b++ )
+			if ( reach[a] && reach[b] && dom[b][a] != li.dominates((int)a, (int)b) )
+				return false;
+	// every back edge target must be a header, every node in a loop
+	// must be dominated by its header
+	for ( size_t v=0; v<n; v++ )
+		if ( li.header[v] >= 0 && !li.dominates(li.header[v], (int)v) )
+			return false;
+	// the source of a back edge is inside the loop of its target
+	for ( size_t v=0; v<n; v++ )
+		for ( const uint32 *p=g.succ_begin(v); p != g.succ_end(v); p++ )
+		{
+			if ( !reach[v] || !dom[v][*p] )
+				continue;
+			int h = li.header[v];
+			while ( h >= 0 && h != (int)*p )
+				h = li.loop_parent[h];
+			if ( h < 0 )
+				return false;
+		}
+	return true;
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	static const size_t defaults[] = { 1000, 10000, 50000, 200000 };
+	std::vector<size_t> sizes;
+	loop_info_t li;
+	cfg_t cfg;
+
+	for ( int i=0; i<200; i++ )
+	{
+		make_cfg(cfg, 5 + rnd(40), 3, false);
+		li.analyse(cfg.view());
+		if ( !check(cfg, li) )
+		{
+			fprintf(stderr, "loopbench: wrong result for graph %d\n", i);
+			return 1;
+		}
+	}
+	printf("200 small graphs checked against iterative dominators.\n");
+
+	for ( int i=1; i<argc; i++ )
+		sizes.push_back((size_t)atoi(argv[i]));
+	if ( sizes.empty() )
+		sizes.assign(defaults, defaults + sizeof(defaults)/sizeof(defaults[0]));
+
+	printf("%8s %8s %8s %8s %8s %8s %10s\n", "blocks", "reached", "edges", "loops", "depth", "irred", "ms");
+	for ( size_t i=0; i<sizes.size(); i++ )
+	{
+		make_cfg(cfg, sizes[i], 2, true);
+		clock_t t = clock();
+		li.analyse(cfg.view());
+		double ms = (clock() - t) * 1000.0 / CLOCKS_PER_SEC;
+		printf("%8u %8u %8u %8u %8d %8u %10.2f\n", (unsigned)sizes[i], (unsigned)li.nreachable,
+			(unsigned)cfg.succ.size(), (unsigned)li.nloops, li.max_depth,
+			(unsigned)li.nirreducible, ms);
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+ *	metricbench - function metrics of a synthetic database
+ *
+ *  Builds a cfg_db_t of many functions, most of them small
+ *  and a few with thousands of blocks, the way real
+ *  databases look, and times metrics_compute() (metrics.cpp)
+ *  with 1, 2, 4, ... threads up to the number of processors.
+ *
+ *  Build (Linux):
+ *    g++ -O2 -pthread -o metricbench metricbench.cpp ../metrics.cpp ../loops.cpp
+ *
+ *  Usage:
+ *    metricbench [functions]      (default 200000)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include <algorithm>
+
+#include "../metrics.hpp"
+
+//--------------------------------------------------------------------------
+static unsigned int rnd_state = 4711;
+
+static unsigned int rnd(unsigned int n)
+{
+	rnd_state = rnd_state * 1103515245 + 12345;
+	return (rnd_state >> 8) % n;
+}
+
+static double now_ms(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// a function of n blocks with branches and loops
+static void make_cfg(cfg_t &cfg, ea_t ea, size_t n)
+{
+	std::vector<uint32> t;
+
+	cfg.func = ea;
+	cfg.clear();
+	for ( size_t i=0; i<n; i++ )
+	{
+		cfg_block_t b = { (ea_t)(ea + i*16), (ea_t)(ea + i*16 + 16), 1 + rnd(8), rnd(2), rnd(3) };
+		cfg.blocks.push_back(b);
+
+		t.clear();
+		if ( i+1 < n )
+			t.push_back((uint32)(i+1));
+		if ( rnd(2) == 0 )
+		{
+			int to = (int)i + (int)rnd(24) - 8;
+			if ( to >= 0 && to < (int)n )
+				t.push_back((uint32)to);
+		}
+		std::sort(t.begin(), t.end());
+		t.erase(std::unique(t.begin(), t.end()), t.end());
+		cfg.succ.insert(cfg.succ.end(), t.begin(), t.end());
+		cfg.succ_off.push_back((uint32)cfg.succ.size());
+	}
+}
+
+//--------------------------------------------------------------------------
+int main(int argc, char *argv[])
+{
+	size_t qty = argc > 1 ? (size_t)atoi(argv[1]) : 200000;
+	std::vector<func_metrics_t> m;
+	cfg_db_t db;
+	cfg_t cfg;
+	ea_t ea = 0x401000;
+
+	db.clear();
+	for ( size_t i=0; i<qty; i++ )
+	{
+		// sizes fall off like in real code
+		size_t n = 1 + rnd(16);
+		if ( rnd(20) == 0 )
+			n = 1 + rnd(400);
+		if ( rnd(2000) == 0 )
+			n = 1 + rnd(20000);
+		make_cfg(cfg, ea, n);
+		db.add(cfg);
+		ea += (ea_t)(n * 16);
+	}
+	printf("%u functions, %u blocks, %u edges\n",
+		(unsigned)db.size(), (unsigned)db.blocks.size(), (unsigned)db.succ.size());
+
+	int cpus = metrics_cpus();
+	for ( int n=1; ; n*=2 )
+	{
+		if ( n > cpus )
+			n = cpus;
+		double t = now_ms();
+		metrics_compute(db, m, n);
+		printf("%3d threads %10.1f ms\n", n, now_ms() - t);
+		if ( n == cpus )
+			break;
+	}
+
+	size_t loops = 0, deepest = 0;
+	for ( size_t i=0; i<m.size(); i++ )
+	{
+		loops += m[i].loops;
+		if ( m[i].max_depth > m[deepest].max_depth )
+			deepest = i;
+	}
+	if ( !m.empty() )
+		printf("%u loops, deepest nesting %u at %08X\n",
+			(unsigned)loops, m[deepest].max_depth, m[deepest].func);
+	return 0;
+}
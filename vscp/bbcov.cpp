@@ -0,0 +1,217 @@
+// * VSCP - basic block coverage
+// *
+// * The blocks are found the same way the
+// * flowgraph plugin does it (gather_basic_blocks()
+// * in graphtest2): decode instructions from the
+// * start of the function until is_basic_block_end()
+// * says so, the next instruction starts a new block.
+// *
+// * The id of a block is its index in the sorted
+// * block array, the coverage bitmap is indexed
+// * by it. A block is looked up once, when its
+// * breakpoint fires and removes itself.
+// *
+// * drcov files consist of a text header with the
+// * module table and a binary table of
+// *   uint32 offset (from the module base)
+// *   uint16 size
+// *   uint16 module id
+// * per covered block.
+// *
+
+#include <algorithm>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <bytes.hpp>
+#include <funcs.hpp>
+#include <ua.hpp>
+#include <nalt.hpp>
+#include <diskio.hpp>
+
+#include "bbcov.hpp"
+
+struct block_t
+{
+	ea_t start;
+	asize_t size;
+};
+
+#pragma pack(push, 1)
+struct drcov_bb_t
+{
+	uint32 start;	//offset from the module base
+	ushort size;
+	ushort mod_id;
+};
+#pragma pack(pop)
+
+static std::vector<block_t> blocks;		//sorted
+static std::vector<uint32> bits;
+static size_t covered=0;
+//-------------------------------------------------------------
+
+
+static bool block_cmp(const block_t &a, const block_t &b)
+{
+	return a.start < b.start;
+}
+
+static bool is_covered(size_t i)
+{
+	return (bits[i >> 5] & (1u << (i & 31))) != 0;
+}
+
+//appends the basic blocks between ea1 and ea2 to 'blocks'
+static void gather_basic_blocks(ea_t ea1, ea_t ea2)
+{
+	ea_t start = BADADDR;
+
+	while( ea1 < ea2 )
+	{
+		if( start == BADADDR )
+		{
+			start = nextthat(ea1 - 1, ea2, f_isCode, NULL);
+			if( start >= ea2 || start == BADADDR )
+				break;
+			ea1 = start;
+		}
+		while( ea1 < ea2 )
+		{
+			if( !ua_ana0(ea1) )
+				break;
+			ea1 = get_item_end(ea1);
+			if( is_basic_block_end(false) )
+				break;
+		}
+		if( ea1 == start )
+		{
+			//not an instruction, look for the next one
+			ea1++;
+			start = BADADDR;
+			continue;
+		}
+
+		block_t b;
+		b.start = start;
+		b.size = ea1 - start;
+		blocks.push_back(b);
+
+		start = isCode(get_flags_novalue(ea1)) ? ea1 : BADADDR;
+	}
+}
+//-------------------------------------------------------------
+
+
+bool bbc_reset(const eavec_t &funcs, eavec_t &eas)
+{
+	bool ok = true;
+
+	blocks.clear();
+	show_wait_box("Finding basic blocks");
+	for( size_t i=0; i<funcs.size(); i++ )
+	{
+		func_t *f = get_func(funcs[i]);
+		if( f == NULL )
+			continue;
+		if( (i & 255) == 0 && wasBreak() )
+		{
+			ok = false;
+			break;
+		}
+		gather_basic_blocks(f->startEA, f->endEA);
+	}
+	hide_wait_box();
+
+	std::sort(blocks.begin(), blocks.end(), block_cmp);
+	bits.assign((blocks.size() + 31) / 32, 0);
+	covered = 0;
+	if( !ok )
+	{
+		blocks.clear();
+		bits.clear();
+		return false;
+	}
+
+	eas.reserve(eas.size() + blocks.size());
+	for( size_t i=0; i<blocks.size(); i++ )
+		eas.push_back(blocks[i].start);
+	return true;
+}
+
+bool bbc_hit(ea_t ea)
+{
+	block_t key;
+	size_t i;
+
+	key.start = ea;
+	std::vector<block_t>::iterator p = std::lower_bound(blocks.begin(), blocks.end(), key, block_cmp);
+	if( p == blocks.end() || p->start != ea )
+		return false;
+	i = p - blocks.begin();
+	if( !is_covered(i) )
+	{
+		bits[i >> 5] |= 1u << (i & 31);
+		covered++;
+	}
+	return true;
+}
+
+size_t bbc_qty(void)
+{
+	return blocks.size();
+}
+
+size_t bbc_covered(void)
+{
+	return covered;
+}
+
+bool bbc_get(size_t i, ea_t *start, asize_t *size)
+{
+	*start = blocks[i].start;
+	*size = blocks[i].size;
+	return is_covered(i);
+}
+//-------------------------------------------------------------
+
+
+bool bbc_export(const char *file)
+{
+	char path[QMAXPATH];
+	ea_t base, end;
+	FILE *fp;
+
+	fp = qfopen(file, "wb");
+	if( fp == NULL )
+		return false;
+
+	base = get_imagebase();
+	end = inf.maxEA;
+	if( get_input_file_path(path, sizeof(path)) == NULL )
+		qstrncpy(path, "?", sizeof(path));
+
+	qfprintf(fp,
+		"DRCOV VERSION: 2\n"
+		"DRCOV FLAVOR: drcov\n"
+		"Module Table: version 2, count 1\n"
+		"Columns: id, base, end, entry, checksum, timestamp, path\n"
+		" 0, 0x%08X, 0x%08X, 0x%08X, 0x00000000, 0x00000000, %s\n"
+		"BB Table: %u bbs\n",
+		base, end, inf.beginEA, path, (ulong)covered);
+
+	for( size_t i=0; i<blocks.size(); i++ )
+	{
+		if( !is_covered(i) )
+			continue;
+
+		drcov_bb_t bb;
+		bb.start = (uint32)(blocks[i].start - base);
+		bb.size = (ushort)qmin(blocks[i].size, (asize_t)0xFFFF);
+		bb.mod_id = 0;
+		qfwrite(fp, &bb, sizeof(bb));
+	}
+	qfclose(fp);
+	return true;
+}
@@ -0,0 +1,32 @@
+// * VSCP - basic block coverage
+// *
+// * One-shot breakpoints on every basic block of
+// * the functions in scope, one bit per block.
+// * The result can be written as a drcov file,
+// * which Lighthouse, bncov and the AFL tooling
+// * around DynamoRIO read.
+// *
+
+#ifndef __BBCOV_HPP
+#define __BBCOV_HPP
+
+#include "bpts.hpp"
+
+//finds the basic blocks of the (sorted) functions at 'funcs',
+//appends their start addresses to 'eas' and starts a new
+//coverage set. false if the user cancelled
+bool bbc_reset(const eavec_t &funcs, eavec_t &eas);
+
+//marks the block at 'ea' as covered, false if there is none
+bool bbc_hit(ea_t ea);
+
+size_t bbc_qty(void);
+size_t bbc_covered(void);
+
+//the i-th block in address order, true if it was covered
+bool bbc_get(size_t i, ea_t *start, asize_t *size);
+
+//drcov version 2, a single module (the input file)
+bool bbc_export(const char *file);
+
+#endif // __BBCOV_HPP
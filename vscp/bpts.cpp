@@ -0,0 +1,228 @@
+// * VSCP - breakpoint bookkeeping
+// *
+// * Adding breakpoints one by one with add_bpt()
+// * makes the debugger kernel update its lists
+// * (and the breakpoint window) for every single
+// * one, which takes minutes for 100k functions.
+// * Requests are queued instead and carried out by
+// * a single run_requests() call.
+// *
+// * The addresses of our breakpoints are kept as
+// * a sorted array, which is also stored in the
+// * database so that they can be removed after
+// * IDA was restarted. Breakpoints deleted one at
+// * a time (coverage mode) only get a mark, the
+// * ones added one at a time (return sites in
+// * timing mode) go to a small set. Both are
+// * folded into the array before it is changed
+// * or saved.
+// *
+
+#include <algorithm>
+#include <set>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <netnode.hpp>
+
+#include "bpts.hpp"
+
+#define BPTS_NODE	"$ vscp breakpoints"
+#define BPTS_TAG	'B'
+
+static eavec_t owned;		//sorted
+static std::vector<bool> gone;	//parallel to 'owned'
+static size_t gone_qty=0;
+static std::set<ea_t> extra;	//added by bpts_add_one()
+static bool loaded=false;
+//-------------------------------------------------------------
+
+
+static void load(void)
+{
+	netnode n(BPTS_NODE);
+	size_t size;
+
+	loaded = true;
+	owned.clear();
+	if( n == BADNODE )
+		return;
+	size = n.blobsize(0, BPTS_TAG);
+	if( size == 0 )
+		return;
+	owned.resize(size / sizeof(ea_t));
+	n.getblob(&owned[0], &size, 0, BPTS_TAG);
+	gone.assign(owned.size(), false);
+	gone_qty = 0;
+}
+
+static void compact(void)
+{
+	size_t i, j;
+
+	if( gone_qty == 0 && extra.empty() )
+		return;
+	for( i=j=0; i<owned.size(); i++ )
+	{
+		if( !gone[i] )
+			owned[j++] = owned[i];
+	}
+	owned.resize(j);
+
+	eavec_t merged;
+	merged.reserve(owned.size() + extra.size());
+	std::merge(owned.begin(), owned.end(), extra.begin(), extra.end(), std::back_inserter(merged));
+	owned.swap(merged);
+	extra.clear();
+
+	gone.assign(owned.size(), false);
+	gone_qty = 0;
+}
+
+static void save(void)
+{
+	compact();
+	netnode n;
+	n.create(BPTS_NODE);
+	n.delblob(0, BPTS_TAG);
+	if( !owned.empty() )
+		n.setblob(&owned[0], owned.size() * sizeof(ea_t), 0, BPTS_TAG);
+}
+//-------------------------------------------------------------
+
+
+size_t bpts_install(eavec_t &eas, int flags)
+{
+	eavec_t added;
+	eavec_t ours;
+	size_t i;
+	bpt_t bpt;
+
+	if( !loaded )
+		load();
+	compact();
+
+	std::sort(eas.begin(), eas.end());
+	eas.erase(std::unique(eas.begin(), eas.end()), eas.end());
+
+	//never take over a breakpoint of the user
+	added.reserve(eas.size());
+	ours.reserve(eas.size());
+	for( i=0; i<eas.size(); i++ )
+	{
+		if( !exist_bpt(eas[i]) )
+		{
+			request_add_bpt(eas[i]);
+			added.push_back(eas[i]);
+			ours.push_back(eas[i]);
+		}
+		else if( std::binary_search(owned.begin(), owned.end(), eas[i]) )
+			ours.push_back(eas[i]);
+	}
+	run_requests();
+
+	//second batch: the breakpoints exist now, change their flags
+	for( i=0; i<added.size(); i++ )
+	{
+		if( get_bpt(added[i], &bpt) )
+		{
+			bpt.flags = flags;
+			request_update_bpt(&bpt);
+		}
+	}
+	run_requests();
+
+	//both arrays are sorted
+	eavec_t merged;
+	merged.reserve(owned.size() + added.size());
+	std::merge(owned.begin(), owned.end(), added.begin(), added.end(), std::back_inserter(merged));
+	owned.swap(merged);
+	gone.assign(owned.size(), false);
+	save();
+
+	if( ours.size() != eas.size() )
+		msg("VSCP: %u addresses already had a breakpoint, they were left alone.\n",
+			(ulong)(eas.size() - ours.size()));
+	eas.swap(ours);
+	return added.size();
+}
+//-------------------------------------------------------------
+
+
+size_t bpts_remove(void)
+{
+	size_t qty;
+
+	if( !loaded )
+		load();
+	compact();
+
+	qty = owned.size();
+	for( size_t i=0; i<qty; i++ )
+		request_del_bpt(owned[i]);
+	run_requests();
+
+	owned.clear();
+	gone.clear();
+	save();
+	return qty;
+}
+//-------------------------------------------------------------
+
+
+bool bpts_add_one(ea_t ea, int flags)
+{
+	bpt_t bpt;
+
+	if( exist_bpt(ea) || !add_bpt(ea) )
+		return false;
+	if( get_bpt(ea, &bpt) )
+	{
+		bpt.flags = flags;
+		update_bpt(&bpt);
+	}
+	extra.insert(ea);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+static ptrdiff_t index_of(ea_t ea)
+{
+	eavec_t::iterator p;
+
+	if( !loaded )
+		load();
+	p = std::lower_bound(owned.begin(), owned.end(), ea);
+	if( p == owned.end() || *p != ea || gone[p - owned.begin()] )
+		return -1;
+	return p - owned.begin();
+}
+
+void bpts_forget(ea_t ea)
+{
+	ptrdiff_t i;
+
+	if( extra.erase(ea) != 0 )
+		return;
+	i = index_of(ea);
+	if( i >= 0 )
+	{
+		gone[i] = true;
+		gone_qty++;
+	}
+}
+
+bool bpts_owned(ea_t ea)
+{
+	return index_of(ea) >= 0 || extra.find(ea) != extra.end();
+}
+
+size_t bpts_qty(void)
+{
+	if( !loaded )
+		load();
+	return owned.size() - gone_qty + extra.size();
+}
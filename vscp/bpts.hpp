@@ -0,0 +1,35 @@
+// * VSCP - breakpoint bookkeeping
+// *
+// * Installs and removes the profiling breakpoints
+// * as one batch of debugger requests and remembers
+// * which breakpoints belong to VSCP, so that
+// * breakpoints set by the user are never touched.
+// *
+
+#ifndef __BPTS_HPP
+#define __BPTS_HPP
+
+#include <vector>
+
+typedef std::vector<ea_t> eavec_t;
+
+//adds a breakpoint at every address in 'eas' which
+//doesn't have one yet, returns the number installed.
+//Afterwards 'eas' holds the (sorted) addresses which
+//carry a VSCP breakpoint, old ones included
+size_t bpts_install(eavec_t &eas, int flags);
+
+//removes all VSCP breakpoints, returns their number
+size_t bpts_remove(void);
+
+//adds a single breakpoint right away (while the process
+//runs), false if there is one already
+bool bpts_add_one(ea_t ea, int flags);
+
+//forgets a VSCP breakpoint that was deleted with del_bpt()
+void bpts_forget(ea_t ea);
+
+bool bpts_owned(ea_t ea);
+size_t bpts_qty(void);
+
+#endif // __BPTS_HPP
@@ -0,0 +1,386 @@
+// * VSCP - dynamic call graph
+// *
+// * Edges live in an open addressing hash table
+// * keyed by the (caller, callee) pair, which
+// * doubles when it gets half full. Counting a
+// * call is one hash and usually one compare, in
+// * contrast to dbgext/callgraph.idc, which
+// * searched the whole .vcg file for every call.
+// *
+// * The graph viewer shows one node per function
+// * with its total number of incoming calls, the
+// * edges are drawn thicker the more often they
+// * were taken.
+// *
+
+#include <windows.h>
+
+#include <algorithm>
+#include <string>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <funcs.hpp>
+#include <graph.hpp>
+#include <diskio.hpp>
+#include <netnode.hpp>
+
+#include "callgraph.hpp"
+
+struct cg_edge_t
+{
+	ea_t caller;
+	ea_t callee;		//BADADDR if the slot is free
+	ulong count;
+};
+
+static cg_edge_t *table=NULL;
+static size_t table_size=0;		//power of 2
+static size_t used=0;
+
+//nodes of the graph viewer / the exports
+static std::vector<ea_t> nodes;		//sorted
+static std::vector<ulong> node_calls;
+static std::vector<std::string> node_text;
+
+static bool hooked=false;
+static netnode id;
+static const char title[] = "VSCP - Call graph";
+//-------------------------------------------------------------
+
+
+static inline size_t slot_of(ea_t caller, ea_t callee)
+{
+	uint64 key = ((uint64)caller << 32) | callee;
+	return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & (table_size - 1);
+}
+
+static bool grow(void)
+{
+	cg_edge_t *old = table;
+	size_t old_size = table_size;
+	size_t i;
+
+	table_size = old_size != 0 ? old_size * 2 : 1024;
+	table = (cg_edge_t *)qalloc(table_size * sizeof(cg_edge_t));
+	if( table == NULL )
+	{
+		table = old;
+		table_size = old_size;
+		return false;
+	}
+	for( i=0; i<table_size; i++ )
+		table[i].callee = BADADDR;
+
+	for( i=0; i<old_size; i++ )
+	{
+		if( old[i].callee == BADADDR )
+			continue;
+		size_t s = slot_of(old[i].caller, old[i].callee);
+		while( table[s].callee != BADADDR )
+			s = (s + 1) & (table_size - 1);
+		table[s] = old[i];
+	}
+	qfree(old);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+void cg_reset(void)
+{
+	qfree(table);
+	table = NULL;
+	table_size = used = 0;
+	nodes.clear();
+}
+
+void cg_add(ea_t caller, ea_t callee)
+{
+	size_t s;
+
+	if( 2 * (used + 1) > table_size && !grow() )
+		return;
+
+	s = slot_of(caller, callee);
+	for(;;)
+	{
+		cg_edge_t &e = table[s];
+		if( e.callee == callee && e.caller == caller )
+		{
+			e.count++;
+			return;
+		}
+		if( e.callee == BADADDR )
+		{
+			e.caller = caller;
+			e.callee = callee;
+			e.count = 1;
+			used++;
+			return;
+		}
+		s = (s + 1) & (table_size - 1);
+	}
+}
+
+void cg_record(ea_t callee)
+{
+	regval_t esp;
+	uint32 ret;
+	func_t *f;
+
+	//we are at the first instruction, [esp] is the return address
+	if( !get_reg_val("esp", &esp)
+		|| read_dbg_memory((ea_t)esp.ival, &ret, sizeof(ret)) != sizeof(ret) )
+		return;
+
+	f = get_func(ret);
+	cg_add(f != NULL ? f->startEA : CG_EXTERNAL, callee);
+}
+
+size_t cg_qty(void)
+{
+	return used;
+}
+//-------------------------------------------------------------
+
+
+static int node_of(ea_t ea)
+{
+	return (int)(std::lower_bound(nodes.begin(), nodes.end(), ea) - nodes.begin());
+}
+
+//collects the functions taking part in a call
+static void build_nodes(void)
+{
+	size_t i;
+
+	nodes.clear();
+	for( i=0; i<table_size; i++ )
+	{
+		if( table[i].callee == BADADDR )
+			continue;
+		nodes.push_back(table[i].caller);
+		nodes.push_back(table[i].callee);
+	}
+	std::sort(nodes.begin(), nodes.end());
+	nodes.erase(std::unique(nodes.begin(), nodes.end()), nodes.end());
+
+	node_calls.assign(nodes.size(), 0);
+	for( i=0; i<table_size; i++ )
+	{
+		if( table[i].callee != BADADDR )
+			node_calls[node_of(table[i].callee)] += table[i].count;
+	}
+}
+
+static void node_name(ea_t ea, char *buf, size_t bufsize)
+{
+	if( ea == CG_EXTERNAL )
+		qstrncpy(buf, "<external>", bufsize);
+	else if( get_func_name(ea, buf, bufsize) == NULL )
+		qsnprintf(buf, bufsize, "%08X", ea);
+}
+//-------------------------------------------------------------
+
+
+static bool export_dot(FILE *fp)
+{
+	char name[MAXSTR];
+	size_t i;
+
+	qfprintf(fp, "digraph vscp {\n");
+	for( i=0; i<nodes.size(); i++ )
+	{
+		node_name(nodes[i], name, sizeof(name));
+		qfprintf(fp, "\tn%u [label=\"%s\\n%u\"];\n", (ulong)i, name, node_calls[i]);
+	}
+	for( i=0; i<table_size; i++ )
+	{
+		const cg_edge_t &e = table[i];
+		if( e.callee != BADADDR )
+			qfprintf(fp, "\tn%d -> n%d [label=\"%u\"];\n",
+				node_of(e.caller), node_of(e.callee), e.count);
+	}
+	qfprintf(fp, "}\n");
+	return true;
+}
+
+static bool export_gml(FILE *fp)
+{
+	char name[MAXSTR];
+	size_t i;
+
+	qfprintf(fp, "graph [\n\tdirected 1\n");
+	for( i=0; i<nodes.size(); i++ )
+	{
+		node_name(nodes[i], name, sizeof(name));
+		qfprintf(fp, "\tnode [ id %u label \"%s\" address %u calls %u ]\n",
+			(ulong)i, name, nodes[i], node_calls[i]);
+	}
+	for( i=0; i<table_size; i++ )
+	{
+		const cg_edge_t &e = table[i];
+		if( e.callee != BADADDR )
+			qfprintf(fp, "\tedge [ source %d target %d weight %u ]\n",
+				node_of(e.caller), node_of(e.callee), e.count);
+	}
+	qfprintf(fp, "]\n");
+	return true;
+}
+
+bool cg_export(const char *file)
+{
+	const char *ext = strrchr(file, '.');
+	FILE *fp;
+	bool ok;
+
+	fp = qfopen(file, "w");
+	if( fp == NULL )
+		return false;
+	build_nodes();
+	if( ext != NULL && stricmp(ext, ".gml") == 0 )
+		ok = export_gml(fp);
+	else
+		ok = export_dot(fp);
+	qfclose(fp);
+	return ok;
+}
+//-------------------------------------------------------------
+
+
+static int edge_width(ulong count)
+{
+	int w = 1;
+	while( count >= 10 && w < 8 )
+	{
+		count /= 10;
+		w++;
+	}
+	return w;
+}
+
+static int idaapi callback(void *, int code, va_list va)
+{
+	int result = 0;
+	switch ( code )
+	{
+	case grcode_user_refresh: // refresh user-defined graph nodes and edges
+		// in:  mutable_graph_t *g
+		// out: success
+		{
+			mutable_graph_t *g = va_arg(va, mutable_graph_t *);
+			if ( g->gid != id )
+				break;
+
+			build_nodes();
+			g->clear();
+			g->resize( (int)nodes.size() );
+			for ( size_t i=0; i<table_size; i++ )
+			{
+				const cg_edge_t &e = table[i];
+				if ( e.callee == BADADDR )
+					continue;
+				edge_info_t ei;
+				ei.width = edge_width(e.count);
+				g->add_edge(node_of(e.caller), node_of(e.callee), &ei);
+			}
+			result = true;
+		}
+		break;
+
+	case grcode_user_gentext: // generate text for user-defined graph nodes
+		// in:  mutable_graph_t *g
+		// out: must return 0
+		{
+			mutable_graph_t *g = va_arg(va, mutable_graph_t *);
+			if ( g->gid != id )
+				break;
+
+			node_text.resize(nodes.size());
+			for ( size_t n=0; n<nodes.size(); n++ )
+			{
+				char name[MAXSTR];
+				char buf[MAXSTR];
+				node_name(nodes[n], name, sizeof(name));
+				qsnprintf(buf, sizeof(buf), "%s\ncalls %u", name, node_calls[n]);
+				node_text[n] = buf;
+			}
+			result = true;
+		}
+		break;
+
+	case grcode_user_text:    // retrieve text for user-defined graph node
+		// in:  mutable_graph_t *g
+		//      int node
+		//      const char **result
+		//      bgcolor_t *bg_color (maybe NULL)
+		// out: must return 0, result must be filled
+		{
+			mutable_graph_t *g = va_arg(va, mutable_graph_t *);
+			int node           = va_argi(va, int);
+			const char **text  = va_arg(va, const char **);
+			if ( g->gid != id || node >= (int)node_text.size() )
+				break;
+			*text = node_text[node].c_str();
+			result = true;
+		}
+		break;
+
+	case grcode_dblclicked:   // a graph node has been double clicked
+		// in:  graph_viewer_t *gv
+		//      selection_item_t *current_item
+		// out: 0-ok, 1-ignore click
+		{
+			graph_viewer_t *v   = va_arg(va, graph_viewer_t *);
+			selection_item_t *s = va_arg(va, selection_item_t *);
+			if ( get_viewer_graph(v)->gid != id )
+				break;
+			if ( s->is_node && s->node < (int)nodes.size() && nodes[s->node] != CG_EXTERNAL )
+				jumpto(nodes[s->node]);
+		}
+		break;
+	}
+	return result;
+}
+
+void cg_show(void)
+{
+	HWND hwnd = NULL;
+	graph_viewer_t *gv;
+	TForm *form;
+
+	if( used == 0 )
+	{
+		msg("VSCP: no calls recorded yet.\n");
+		return;
+	}
+
+	form = create_tform(title, &hwnd);
+	if ( hwnd == NULL )
+	{
+		//already open, show the current state
+		refresh_viewer( get_graph_viewer(form) );
+		return;
+	}
+	if ( !hooked )
+	{
+		hooked = true;
+		hook_to_notification_point(HT_GRAPH, callback, NULL);
+	}
+	// get a unique graph id
+	id.create();
+	gv = create_graph_viewer( form, id );
+	open_tform( form, FORM_MDI|FORM_TAB|FORM_MENU );
+	if ( gv != NULL )
+		viewer_fit_window( gv );
+}
+
+void cg_term(void)
+{
+	if ( hooked )
+		unhook_from_notification_point(HT_GRAPH, callback);
+	hooked = false;
+}
@@ -0,0 +1,29 @@
+// * VSCP - dynamic call graph
+// *
+// * Counts caller -> callee edges while hits are
+// * being counted. The caller is the function the
+// * return address on the stack points into.
+// *
+
+#ifndef __CALLGRAPH_HPP
+#define __CALLGRAPH_HPP
+
+//caller of calls coming from outside of any function
+#define CG_EXTERNAL		BADADDR
+
+void cg_reset(void);
+
+//counts a call of 'callee', reads the return address
+//of the current thread to find the caller
+void cg_record(ea_t callee);
+
+void cg_add(ea_t caller, ea_t callee);
+size_t cg_qty(void);
+
+//writes a .gml file if the name ends with ".gml", DOT otherwise
+bool cg_export(const char *file);
+
+void cg_show(void);
+void cg_term(void);
+
+#endif // __CALLGRAPH_HPP
@@ -0,0 +1,134 @@
+// * VSCP - function coverage
+// *
+// * The bit of a function is its index in the
+// * sorted array of addresses, which is found by
+// * a binary search. This only happens once per
+// * function, as the breakpoint is gone after it.
+// *
+// * The overlay uses the function colors of the
+// * database. The old colors are remembered and
+// * put back by cov_unpaint().
+// *
+
+#include <algorithm>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <funcs.hpp>
+#include <diskio.hpp>
+
+#include "cover.hpp"
+
+#define COVER_COLOR		0xC0FFC0	//light green (BGR)
+
+static eavec_t funcs;				//sorted
+static std::vector<uint32> bits;
+static size_t covered=0;
+
+//functions painted by cov_paint() and their former colors
+static std::vector<std::pair<ea_t, bgcolor_t> > painted;
+//-------------------------------------------------------------
+
+
+static bool is_covered(size_t i)
+{
+	return (bits[i >> 5] & (1u << (i & 31))) != 0;
+}
+
+void cov_reset(const eavec_t &eas)
+{
+	funcs = eas;
+	bits.assign((funcs.size() + 31) / 32, 0);
+	covered = 0;
+}
+
+bool cov_hit(ea_t ea)
+{
+	eavec_t::iterator p = std::lower_bound(funcs.begin(), funcs.end(), ea);
+	size_t i;
+
+	if( p == funcs.end() || *p != ea )
+		return false;
+	i = p - funcs.begin();
+	if( !is_covered(i) )
+	{
+		bits[i >> 5] |= 1u << (i & 31);
+		covered++;
+	}
+	return true;
+}
+
+size_t cov_qty(void)
+{
+	return funcs.size();
+}
+
+size_t cov_covered(void)
+{
+	return covered;
+}
+
+bool cov_get(size_t i, ea_t *ea)
+{
+	*ea = funcs[i];
+	return is_covered(i);
+}
+//-------------------------------------------------------------
+
+
+//one line per covered function: address and name
+bool cov_export(const char *file)
+{
+	char name[MAXSTR];
+	FILE *fp;
+
+	fp = qfopen(file, "w");
+	if( fp == NULL )
+		return false;
+
+	qfprintf(fp, "; VSCP coverage, %u of %u functions\n",
+		(ulong)covered, (ulong)funcs.size());
+	for( size_t i=0; i<funcs.size(); i++ )
+	{
+		if( !is_covered(i) )
+			continue;
+		if( get_func_name(funcs[i], name, sizeof(name)) == NULL )
+			qstrncpy(name, "?", sizeof(name));
+		qfprintf(fp, "%08X %s\n", funcs[i], name);
+	}
+	qfclose(fp);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+void cov_paint(void)
+{
+	cov_unpaint();
+	for( size_t i=0; i<funcs.size(); i++ )
+	{
+		func_t *f;
+		if( !is_covered(i) || (f = get_func(funcs[i])) == NULL )
+			continue;
+		painted.push_back(std::make_pair(funcs[i], f->color));
+		f->color = COVER_COLOR;
+		update_func(f);
+	}
+	refresh_idaview_anyway();
+}
+
+void cov_unpaint(void)
+{
+	for( size_t i=0; i<painted.size(); i++ )
+	{
+		func_t *f = get_func(painted[i].first);
+		if( f == NULL )
+			continue;
+		f->color = painted[i].second;
+		update_func(f);
+	}
+	if( !painted.empty() )
+		refresh_idaview_anyway();
+	painted.clear();
+}
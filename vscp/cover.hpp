@@ -0,0 +1,32 @@
+// * VSCP - function coverage
+// *
+// * One bit per function with a VSCP breakpoint.
+// * The breakpoints remove themselves on their
+// * first hit, so a function costs at most one
+// * debug event.
+// *
+
+#ifndef __COVER_HPP
+#define __COVER_HPP
+
+#include "bpts.hpp"
+
+//starts a new coverage set for the (sorted) functions at 'eas'
+void cov_reset(const eavec_t &eas);
+
+//marks 'ea' as covered, false if it isn't part of the set
+bool cov_hit(ea_t ea);
+
+size_t cov_qty(void);
+size_t cov_covered(void);
+
+//the i-th function in address order, true if it was covered
+bool cov_get(size_t i, ea_t *ea);
+
+bool cov_export(const char *file);
+
+//colors the covered functions / restores their colors
+void cov_paint(void);
+void cov_unpaint(void);
+
+#endif // __COVER_HPP
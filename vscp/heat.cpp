@@ -0,0 +1,244 @@
+// * VSCP - heatmap
+// *
+// * bucket = 1 + 6 * log(hits) / log(max hits),
+// * so a function with one hit and the hottest one
+// * are always at both ends of the gradient.
+// *
+// * Functions which were only covered (function or
+// * block coverage) but not profiled get bucket 1.
+// *
+// * Blocks have no hit counts of their own (their
+// * breakpoints are one-shot), a covered block gets
+// * the bucket of its function, a block that didn't
+// * run gets bucket 0. This shows the cold paths
+// * inside hot functions.
+// *
+// * Everything is computed once by heat_build(),
+// * painting only looks at the tables.
+// *
+
+#include <windows.h>
+
+#include <math.h>
+#include <map>
+
+//vpf.hpp uses stdio
+#define USE_STANDARD_FILE_FUNCTIONS
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <bytes.hpp>
+#include <funcs.hpp>
+#include <netnode.hpp>
+
+#include "vpf.hpp"
+#include "profile.hpp"
+#include "bbcov.hpp"
+#include "cover.hpp"
+#include "heat.hpp"
+
+static std::vector<heat_range_t> func_heat;		//sorted
+static std::vector<heat_range_t> block_heat;	//sorted
+static bgcolor_t palette[HEAT_BUCKETS];
+
+//colors changed by heat_paint() and their former values
+static std::vector<std::pair<ea_t, bgcolor_t> > old_func_colors;
+static std::vector<std::pair<ea_t, bgcolor_t> > old_item_colors;
+//-------------------------------------------------------------
+
+
+static void make_palette(void)
+{
+	//not executed: pale blue
+	palette[0] = RGB(210, 225, 240);
+	//light yellow .. red
+	for( int i=1; i<HEAT_BUCKETS; i++ )
+	{
+		int t = (i - 1) * 255 / (HEAT_BUCKETS - 2);
+		palette[i] = RGB(255, 250 - t * 180 / 255, 200 - t * 150 / 255);
+	}
+}
+
+static uint32 get_bucket(uint64 hits, double logmax)
+{
+	uint32 b;
+
+	if( hits == 0 )
+		return 0;
+	if( logmax <= 0 )
+		return HEAT_BUCKETS - 1;
+	b = 1 + (uint32)((HEAT_BUCKETS - 2) * log((double)hits) / logmax + 0.5);
+	return qmin(b, (uint32)(HEAT_BUCKETS - 1));
+}
+
+static void add_range(std::vector<heat_range_t> &v, ea_t start, ea_t end, uint32 bucket)
+{
+	heat_range_t r;
+	r.start = start;
+	r.end = end;
+	r.bucket = bucket;
+	v.push_back(r);
+}
+
+static void add_covered(std::map<ea_t, heat_range_t> &funcs, ea_t ea)
+{
+	func_t *f = get_func(ea);
+
+	if( f == NULL || funcs.find(f->startEA) != funcs.end() )
+		return;
+	heat_range_t &r = funcs[f->startEA];
+	r.start = f->startEA;
+	r.end = f->endEA;
+	r.bucket = 1;
+}
+
+static void store(void)
+{
+	netnode n;
+	n.create(HEAT_NODE);
+	n.delblob(0, 'F');
+	n.delblob(0, 'K');
+	if( !func_heat.empty() )
+		n.setblob(&func_heat[0], func_heat.size() * sizeof(heat_range_t), 0, 'F');
+	if( !block_heat.empty() )
+		n.setblob(&block_heat[0], block_heat.size() * sizeof(heat_range_t), 0, 'K');
+	n.setblob(palette, sizeof(palette), 0, 'P');
+}
+//-------------------------------------------------------------
+
+
+size_t heat_build(void)
+{
+	std::vector<vpf_record_t> recs;
+	std::map<ea_t, heat_range_t> funcs;
+	uint64 max = 0;
+	double logmax;
+	size_t i;
+
+	make_palette();
+	func_heat.clear();
+	block_heat.clear();
+
+	prof_get(recs);
+	for( i=0; i<recs.size(); i++ )
+		max = qmax(max, (uint64)recs[i].hits);
+	logmax = max > 1 ? log((double)max) : 0;
+	for( i=0; i<recs.size(); i++ )
+	{
+		func_t *f = get_func(recs[i].ea);
+		if( f == NULL )
+			continue;
+		heat_range_t &r = funcs[f->startEA];
+		r.start = f->startEA;
+		r.end = f->endEA;
+		r.bucket = get_bucket(recs[i].hits, logmax);
+	}
+
+	//functions only known from the coverage are as cold
+	//as a function can be while still having run
+	for( i=0; i<cov_qty(); i++ )
+	{
+		ea_t ea;
+		if( cov_get(i, &ea) )
+			add_covered(funcs, ea);
+	}
+	for( i=0; i<bbc_qty(); i++ )
+	{
+		ea_t start;
+		asize_t size;
+		if( bbc_get(i, &start, &size) )
+			add_covered(funcs, start);
+	}
+
+	func_heat.reserve(funcs.size());
+	for( std::map<ea_t, heat_range_t>::iterator p=funcs.begin(); p != funcs.end(); ++p )
+		func_heat.push_back(p->second);
+
+	//blocks: both lists are sorted, walk them side by side
+	size_t k = 0;
+	for( i=0; i<bbc_qty(); i++ )
+	{
+		ea_t start;
+		asize_t size;
+		bool covered = bbc_get(i, &start, &size);
+
+		while( k < func_heat.size() && func_heat[k].end <= start )
+			k++;
+		if( k == func_heat.size() )
+			break;
+		if( start < func_heat[k].start )
+			continue;
+		add_range(block_heat, start, start + size, covered ? func_heat[k].bucket : 0);
+	}
+
+	store();
+	return func_heat.size();
+}
+//-------------------------------------------------------------
+
+
+//puts back the colors changed by heat_paint()
+static void restore_colors(void)
+{
+	size_t i;
+
+	for( i=0; i<old_func_colors.size(); i++ )
+	{
+		func_t *f = get_func(old_func_colors[i].first);
+		if( f == NULL )
+			continue;
+		f->color = old_func_colors[i].second;
+		update_func(f);
+	}
+	for( i=0; i<old_item_colors.size(); i++ )
+	{
+		if( old_item_colors[i].second == DEFCOLOR )
+			del_item_color(old_item_colors[i].first);
+		else
+			set_item_color(old_item_colors[i].first, old_item_colors[i].second);
+	}
+	if( !old_func_colors.empty() || !old_item_colors.empty() )
+		refresh_idaview_anyway();
+	old_func_colors.clear();
+	old_item_colors.clear();
+}
+
+void heat_paint(void)
+{
+	size_t i;
+	ea_t ea;
+
+	restore_colors();
+	for( i=0; i<func_heat.size(); i++ )
+	{
+		func_t *f = get_func(func_heat[i].start);
+		if( f == NULL )
+			continue;
+		old_func_colors.push_back(std::make_pair(f->startEA, f->color));
+		f->color = palette[func_heat[i].bucket];
+		update_func(f);
+	}
+	for( i=0; i<block_heat.size(); i++ )
+	{
+		const heat_range_t &r = block_heat[i];
+		for( ea=r.start; ea != BADADDR && ea < r.end; ea=next_head(ea, r.end) )
+		{
+			old_item_colors.push_back(std::make_pair(ea, get_item_color(ea)));
+			set_item_color(ea, palette[r.bucket]);
+		}
+	}
+	refresh_idaview_anyway();
+}
+
+void heat_unpaint(void)
+{
+	restore_colors();
+
+	//the flowgraph of graphtest2 colors by the tables as well
+	netnode n(HEAT_NODE);
+	if( n != BADNODE )
+		n.kill();
+	func_heat.clear();
+	block_heat.clear();
+}
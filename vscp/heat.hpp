@@ -0,0 +1,44 @@
+// * VSCP - heatmap
+// *
+// * Colors functions and basic blocks by their
+// * hit counts, on a logarithmic scale.
+// *
+// * The address -> bucket tables are also stored
+// * in the database, so that other plugins (the
+// * flowgraph of graphtest2) can color their
+// * nodes the same way:
+// *
+// *   netnode "$ vscp heat"
+// *     blob 'F'  heat_range_t[], functions
+// *     blob 'K'  heat_range_t[], basic blocks
+// *     blob 'P'  bgcolor_t[HEAT_BUCKETS]
+// *
+// * Both tables are sorted by address and their
+// * ranges don't overlap. Blocks take precedence
+// * over the function they belong to.
+// *
+
+#ifndef __HEAT_HPP
+#define __HEAT_HPP
+
+#define HEAT_NODE		"$ vscp heat"
+#define HEAT_BUCKETS	8		//0 = not executed, 7 = hottest
+
+struct heat_range_t
+{
+	ea_t start;
+	ea_t end;
+	uint32 bucket;
+};
+
+//builds the tables from the profile and the block coverage
+//and stores them in the database. returns the number of
+//functions with a color
+size_t heat_build(void);
+
+//colors the disassembly / restores the old colors and
+//deletes the tables from the database
+void heat_paint(void);
+void heat_unpaint(void);
+
+#endif // __HEAT_HPP
@@ -0,0 +1,326 @@
+// * VSCP - hit counters
+// *
+// * The counters live in an open addressing hash
+// * table (linear probing, at most half full) which
+// * is filled once when profiling starts, so a hit
+// * is one multiplication and usually a single
+// * compare. Sorting only happens when the chooser
+// * asks for it.
+// *
+// * Times are kept in performance counter ticks
+// * and only converted for display.
+// *
+
+#include <windows.h>
+
+#include <algorithm>
+
+//vpf.hpp uses stdio
+#define USE_STANDARD_FILE_FUNCTIONS
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <funcs.hpp>
+
+#include "vpf.hpp"
+#include "profile.hpp"
+
+struct counter_t
+{
+	ea_t ea;			//BADADDR if the slot is free
+	uint64 hits;
+	uint64 incl;		//ticks
+	uint64 excl;		//ticks
+	int active;			//calls currently on a shadow stack
+};
+
+static counter_t *table=NULL;
+static size_t table_size=0;	//power of 2
+static int table_shift;
+static uint64 total=0;
+static bool timed=false;
+static double tick_ms=0;
+
+//rows of the chooser, functions with hits only
+static std::vector<const counter_t *> rows;
+
+static const char title[] = "VSCP - Profile";
+static const char *header[] = { "Function", "Address", "Hits", "%", "Incl ms", "Excl ms" };
+static const int widths[] = { 32, 10, 12, 7, 12, 12 };
+#define COLUMNS		6
+//-------------------------------------------------------------
+
+
+static inline size_t slot_of(ea_t ea)
+{
+	return (size_t)((uint32)(ea * 2654435761u) >> table_shift);
+}
+
+static counter_t *find(ea_t ea)
+{
+	size_t i = slot_of(ea);
+	for(;;)
+	{
+		counter_t *c = &table[i];
+		if( c->ea == ea )
+			return c;
+		if( c->ea == BADADDR )
+			return NULL;
+		i = (i + 1) & (table_size - 1);
+	}
+}
+//-------------------------------------------------------------
+
+
+void prof_reset(const eavec_t &eas)
+{
+	size_t i;
+
+	table_size = 16;
+	table_shift = 28;
+	while( table_size < 2 * eas.size() )
+	{
+		table_size <<= 1;
+		table_shift--;
+	}
+
+	qfree(table);
+	table = (counter_t *)qalloc(table_size * sizeof(counter_t));
+	if( table == NULL )
+	{
+		table_size = 0;
+		msg("VSCP: not enough memory for %u counters.\n", (ulong)eas.size());
+		return;
+	}
+	memset(table, 0, table_size * sizeof(counter_t));
+	for( i=0; i<table_size; i++ )
+		table[i].ea = BADADDR;
+
+	for( i=0; i<eas.size(); i++ )
+	{
+		size_t s = slot_of(eas[i]);
+		while( table[s].ea != BADADDR && table[s].ea != eas[i] )
+			s = (s + 1) & (table_size - 1);
+		table[s].ea = eas[i];
+	}
+	total = 0;
+	timed = false;
+	rows.clear();
+}
+//-------------------------------------------------------------
+
+
+bool prof_hit(ea_t ea)
+{
+	counter_t *c;
+
+	if( table == NULL )
+		return false;
+	c = find(ea);
+	if( c == NULL )
+		return false;
+	c->hits++;
+	total++;
+	return true;
+}
+
+void prof_enter(ea_t ea)
+{
+	counter_t *c = table != NULL ? find(ea) : NULL;
+	if( c != NULL )
+		c->active++;
+}
+
+void prof_leave(ea_t ea, uint64 incl, uint64 excl)
+{
+	counter_t *c = table != NULL ? find(ea) : NULL;
+	if( c == NULL )
+		return;
+	if( c->active > 0 )
+		c->active--;
+	if( c->active == 0 )
+		c->incl += incl;
+	c->excl += excl;
+	timed = true;
+}
+
+static bool ea_cmp(const vpf_record_t &a, const vpf_record_t &b)
+{
+	return a.ea < b.ea;
+}
+
+//returns true if the records carry times
+bool prof_get(std::vector<vpf_record_t> &recs)
+{
+	char name[MAXSTR];
+	double tick_us;
+	LARGE_INTEGER li;
+
+	QueryPerformanceFrequency(&li);
+	tick_us = 1000000.0 / li.QuadPart;
+
+	recs.clear();
+	for( size_t i=0; i<table_size; i++ )
+	{
+		const counter_t &c = table[i];
+		if( c.hits == 0 )
+			continue;
+		vpf_record_t r;
+		r.ea = (vpf_u32)c.ea;
+		r.name_hash = get_func_name(c.ea, name, sizeof(name)) != NULL ? vpf_name_hash(name) : 0;
+		r.hits = c.hits;
+		r.incl_us = (vpf_u64)(c.incl * tick_us);
+		r.excl_us = (vpf_u64)(c.excl * tick_us);
+		recs.push_back(r);
+	}
+	std::sort(recs.begin(), recs.end(), ea_cmp);
+	return timed;
+}
+
+void prof_load(const std::vector<vpf_record_t> &recs)
+{
+	eavec_t eas;
+	double us_tick;
+	LARGE_INTEGER li;
+	size_t i;
+
+	QueryPerformanceFrequency(&li);
+	us_tick = li.QuadPart / 1000000.0;
+
+	eas.reserve(recs.size());
+	for( i=0; i<recs.size(); i++ )
+		eas.push_back(recs[i].ea);
+	prof_reset(eas);
+	if( table == NULL )
+		return;
+
+	for( i=0; i<recs.size(); i++ )
+	{
+		counter_t *c = find(recs[i].ea);
+		c->hits = recs[i].hits;
+		c->incl = (uint64)(recs[i].incl_us * us_tick);
+		c->excl = (uint64)(recs[i].excl_us * us_tick);
+		total += c->hits;
+		if( c->incl != 0 || c->excl != 0 )
+			timed = true;
+	}
+}
+
+uint64 prof_total(void)
+{
+	return total;
+}
+//-------------------------------------------------------------
+
+
+static bool hits_cmp(const counter_t *a, const counter_t *b)
+{
+	if( a->hits != b->hits )
+		return a->hits > b->hits;
+	return a->ea < b->ea;
+}
+
+static bool excl_cmp(const counter_t *a, const counter_t *b)
+{
+	if( a->excl != b->excl )
+		return a->excl > b->excl;
+	return hits_cmp(a, b);
+}
+
+static void build_rows(void)
+{
+	rows.clear();
+	for( size_t i=0; i<table_size; i++ )
+	{
+		if( table[i].hits != 0 )
+			rows.push_back(&table[i]);
+	}
+	std::sort(rows.begin(), rows.end(), timed ? excl_cmp : hits_cmp);
+
+	if( tick_ms == 0 )
+	{
+		LARGE_INTEGER li;
+		QueryPerformanceFrequency(&li);
+		tick_ms = 1000.0 / li.QuadPart;
+	}
+}
+//-------------------------------------------------------------
+
+
+//callback function for choose2() -> number of lines
+static ulong idaapi get_item_qty(void * /*obj*/)
+{
+	return (ulong)rows.size();
+}
+
+//callback function for choose2() -> returns the n-th line
+static void idaapi getn_item_text(void * /*obj*/, ulong n, char * const *buf)
+{
+	if( n == 0 )
+	{
+		for( int i=0; i<COLUMNS; i++ )
+			qstrncpy(buf[i], header[i], MAXSTR);
+		return;
+	}
+
+	const counter_t *c = rows[n-1];
+	if( get_func_name(c->ea, buf[0], MAXSTR) == NULL )
+		qstrncpy(buf[0], "?", MAXSTR);
+	qsnprintf(buf[1], MAXSTR, "%08X", c->ea);
+	qsnprintf(buf[2], MAXSTR, "%.0f", (double)c->hits);
+	qsnprintf(buf[3], MAXSTR, "%.2f", total != 0 ? c->hits * 100.0 / total : 0.0);
+	if( timed )
+	{
+		qsnprintf(buf[4], MAXSTR, "%.3f", c->incl * tick_ms);
+		qsnprintf(buf[5], MAXSTR, "%.3f", c->excl * tick_ms);
+	}
+	else
+		buf[4][0] = buf[5][0] = '\0';
+}
+
+static ulong idaapi update_list(void * /*obj*/, ulong n)
+{
+	build_rows();
+	return n;
+}
+
+static void idaapi jump_to_item(void * /*obj*/, ulong n)
+{
+	if( n > 0 && n <= rows.size() )
+		jumpto(rows[n-1]->ea);
+}
+//-------------------------------------------------------------
+
+
+void prof_show(void)
+{
+	build_rows();
+	if( refresh_chooser(title) )
+		return;
+
+	choose2(
+		0,						// non-modal
+		-1,-1,-1,-1,			// autoposition
+		NULL,					// the list lives in 'rows'
+		COLUMNS,				// number of columns
+		widths,
+		get_item_qty,
+		getn_item_text,
+		title,
+		-1,						// no icon
+		1,						// starting item
+		NULL,					// "Delete"
+		NULL,					// "New"
+		update_list,			// "Update"
+		NULL,					// "Edit"
+		jump_to_item,			// "Enter"
+		NULL,					// "Destroy"
+		NULL);					// default popup names
+}
+
+//updates the chooser if it is open
+void prof_refresh(void)
+{
+	refresh_chooser(title);
+}
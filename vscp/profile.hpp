@@ -0,0 +1,36 @@
+// * VSCP - hit counters
+// *
+// * Counts the breakpoint hits per function and
+// * shows them in a chooser, sorted by hits (or by
+// * exclusive time, if there is timing data).
+// *
+
+#ifndef __PROFILE_HPP
+#define __PROFILE_HPP
+
+#include "bpts.hpp"
+
+struct vpf_record_t;		//vpf.hpp
+
+//starts a new profile for the functions at 'eas'
+void prof_reset(const eavec_t &eas);
+
+//counts a hit, false if 'ea' isn't being profiled
+bool prof_hit(ea_t ea);
+
+//timing: a call of 'ea' starts / ends. Times are in
+//performance counter ticks. The inclusive time only
+//counts for the outermost call of a recursion
+void prof_enter(ea_t ea);
+void prof_leave(ea_t ea, uint64 incl, uint64 excl);
+
+//the current profile as .vpf records (functions with hits
+//only, sorted by address) / replaces it by saved records
+bool prof_get(std::vector<vpf_record_t> &recs);
+void prof_load(const std::vector<vpf_record_t> &recs);
+
+void prof_show(void);
+void prof_refresh(void);
+uint64 prof_total(void);
+
+#endif // __PROFILE_HPP
@@ -0,0 +1,239 @@
+// * VSCP - saved profiles
+// *
+// * Profiles carry the md5 of the input file, so
+// * runs of a different build are refused when
+// * merging and reported when loading or diffing.
+// *
+
+#include <windows.h>
+
+#include <time.h>
+#include <algorithm>
+
+//vpf.hpp uses stdio
+#define USE_STANDARD_FILE_FUNCTIONS
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <funcs.hpp>
+#include <diskio.hpp>
+
+#include "vpf.hpp"
+#include "profile.hpp"
+#include "runs.hpp"
+
+static std::vector<vpf_diff_t> diffs;
+
+static const char title[] = "VSCP - Profile diff";
+static const char *header[] = { "Function", "Address", "Hits A", "Hits B", "Change" };
+static const int widths[] = { 32, 10, 12, 12, 8 };
+//-------------------------------------------------------------
+
+
+static void make_header(vpf_header_t &h, bool timed)
+{
+	memset(&h, 0, sizeof(h));
+	h.version = VPF_VERSION;
+	h.flags = timed ? VPF_FLAG_TIMED : 0;
+	h.runs = 1;
+	if( !retrieve_input_file_md5(h.md5) )
+		memset(h.md5, 0, sizeof(h.md5));
+}
+
+//warns about profiles of another input file
+static void check_md5(const char *file, const vpf_header_t &h)
+{
+	uchar md5[16];
+	static const uchar nomd5[16] = { 0 };
+
+	if( retrieve_input_file_md5(md5) && memcmp(h.md5, nomd5, 16) != 0
+		&& memcmp(h.md5, md5, 16) != 0 )
+		msg("VSCP: warning, %s was recorded with a different input file.\n", file);
+}
+//-------------------------------------------------------------
+
+
+bool runs_save(const char *file)
+{
+	std::vector<vpf_record_t> recs;
+	vpf_header_t h;
+	bool timed;
+
+	timed = prof_get(recs);
+	make_header(h, timed);
+	if( !vpf_save(file, h, recs) )
+	{
+		msg("VSCP: could not write %s\n", file);
+		return false;
+	}
+	msg("VSCP: profile of %u functions saved to %s\n", (ulong)recs.size(), file);
+	return true;
+}
+
+void runs_autosave(void)
+{
+	char ext[32];
+	char path[QMAXPATH];
+	time_t now = time(NULL);
+	struct tm *t = localtime(&now);
+
+	strftime(ext, sizeof(ext), "%Y%m%d-%H%M%S.vpf", t);
+	set_file_ext(path, sizeof(path), database_idb, ext);
+	runs_save(path);
+}
+
+bool runs_load(const char *file)
+{
+	std::vector<vpf_record_t> recs;
+	vpf_header_t h;
+
+	if( !vpf_load(file, h, recs) )
+	{
+		msg("VSCP: %s is not a profile.\n", file);
+		return false;
+	}
+	check_md5(file, h);
+	prof_load(recs);
+	msg("VSCP: loaded %u functions (%u runs) from %s\n", h.count, h.runs, file);
+	prof_show();
+	return true;
+}
+//-------------------------------------------------------------
+
+
+bool runs_merge(const char *pattern, const char *outfile)
+{
+	std::vector<std::string> files;
+	std::string dir, err;
+	WIN32_FIND_DATA fd;
+	HANDLE h;
+	const char *p;
+
+	//FindFirstFile() only returns the names
+	p = strrchr(pattern, '\\');
+	if( p == NULL )
+		p = strrchr(pattern, '/');
+	if( p != NULL )
+		dir.assign(pattern, p + 1 - pattern);
+
+	h = FindFirstFile(pattern, &fd);
+	if( h != INVALID_HANDLE_VALUE )
+	{
+		do
+		{
+			if( (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0 )
+				files.push_back(dir + fd.cFileName);
+		} while( FindNextFile(h, &fd) );
+		FindClose(h);
+	}
+
+	if( files.empty() )
+	{
+		msg("VSCP: no files match %s\n", pattern);
+		return false;
+	}
+	//the output may match the pattern as well
+	std::sort(files.begin(), files.end());
+	files.erase(std::remove(files.begin(), files.end(), std::string(outfile)), files.end());
+
+	show_wait_box("Merging %u profiles", (ulong)files.size());
+	bool ok = vpf_merge_files(files, outfile, err);
+	hide_wait_box();
+	if( !ok )
+	{
+		msg("VSCP: merge failed, %s\n", err.c_str());
+		return false;
+	}
+	msg("VSCP: %u profiles merged into %s\n", (ulong)files.size(), outfile);
+	return runs_load(outfile);
+}
+//-------------------------------------------------------------
+
+
+//callback function for choose2() -> number of lines
+static ulong idaapi get_item_qty(void * /*obj*/)
+{
+	return (ulong)diffs.size();
+}
+
+//callback function for choose2() -> returns the n-th line
+static void idaapi getn_item_text(void * /*obj*/, ulong n, char * const *buf)
+{
+	if( n == 0 )
+	{
+		for( int i=0; i<5; i++ )
+			qstrncpy(buf[i], header[i], MAXSTR);
+		return;
+	}
+
+	const vpf_diff_t &d = diffs[n-1];
+	if( get_func_name(d.ea, buf[0], MAXSTR) == NULL )
+		qstrncpy(buf[0], "?", MAXSTR);
+	qsnprintf(buf[1], MAXSTR, "%08X", d.ea);
+	qsnprintf(buf[2], MAXSTR, "%.0f", (double)d.hits_a);
+	qsnprintf(buf[3], MAXSTR, "%.0f", (double)d.hits_b);
+	if( d.hits_a == 0 )
+		qstrncpy(buf[4], "new", MAXSTR);
+	else if( d.hits_b == 0 )
+		qstrncpy(buf[4], "gone", MAXSTR);
+	else
+		qsnprintf(buf[4], MAXSTR, "%.2fx", d.ratio);
+}
+
+static void idaapi jump_to_item(void * /*obj*/, ulong n)
+{
+	if( n > 0 && n <= diffs.size() )
+		jumpto(diffs[n-1].ea);
+}
+
+static bool ratio_cmp(const vpf_diff_t &a, const vpf_diff_t &b)
+{
+	if( a.ratio != b.ratio )
+		return a.ratio > b.ratio;
+	return a.ea < b.ea;
+}
+
+bool runs_diff(const char *file_a, const char *file_b, double factor)
+{
+	std::vector<vpf_record_t> a, b;
+	vpf_header_t ha, hb;
+
+	if( !vpf_load(file_a, ha, a) )
+	{
+		msg("VSCP: %s is not a profile.\n", file_a);
+		return false;
+	}
+	if( !vpf_load(file_b, hb, b) )
+	{
+		msg("VSCP: %s is not a profile.\n", file_b);
+		return false;
+	}
+	check_md5(file_a, ha);
+	check_md5(file_b, hb);
+
+	vpf_diff(ha, a, hb, b, factor, diffs);
+	std::sort(diffs.begin(), diffs.end(), ratio_cmp);
+	msg("VSCP: %u functions changed by %.2fx or more.\n", (ulong)diffs.size(), factor);
+
+	close_chooser(title);
+	choose2(
+		0,						// non-modal
+		-1,-1,-1,-1,			// autoposition
+		NULL,					// the list lives in 'diffs'
+		5,						// number of columns
+		widths,
+		get_item_qty,
+		getn_item_text,
+		title,
+		-1,						// no icon
+		1,						// starting item
+		NULL,					// "Delete"
+		NULL,					// "New"
+		NULL,					// "Update"
+		NULL,					// "Edit"
+		jump_to_item,			// "Enter"
+		NULL,					// "Destroy"
+		NULL);					// default popup names
+	return true;
+}
@@ -0,0 +1,24 @@
+// * VSCP - saved profiles
+// *
+// * Saves the profile of every run as a .vpf file
+// * (see vpf.hpp), loads, merges and compares them.
+// *
+
+#ifndef __RUNS_HPP
+#define __RUNS_HPP
+
+//saves the current profile next to the database,
+//<database>.<date>-<time>.vpf
+void runs_autosave(void);
+
+bool runs_save(const char *file);
+bool runs_load(const char *file);
+
+//merges all files matching 'pattern' (wildcards allowed)
+//into 'outfile' and loads the result
+bool runs_merge(const char *pattern, const char *outfile);
+
+//shows the functions whose hits changed by at least 'factor'
+bool runs_diff(const char *file_a, const char *file_b, double factor);
+
+#endif // __RUNS_HPP
@@ -0,0 +1,282 @@
+// * VSCP - statistical sampling
+// *
+// * The sampler thread must not call IDA, so it
+// * only stores raw addresses. Each sample is
+// * [frames][eip][return address]..., innermost
+// * first. Addresses are mapped to functions
+// * once, when sampling stops.
+// *
+// * The overhead depends on the interval, the
+// * stack depth and the number of threads, not on
+// * the number of functions. This only works with
+// * the local win32 debugger, the debuggee's
+// * threads are opened with OpenThread().
+// *
+
+#include <windows.h>
+
+#include <map>
+#include <string>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <funcs.hpp>
+#include <diskio.hpp>
+
+#include "profile.hpp"
+#include "sample.hpp"
+
+//upper limit for the sample buffer (in addresses)
+#define MAX_BUFFER	(16*1024*1024)
+
+struct sthread_t
+{
+	thid_t tid;
+	HANDLE handle;
+};
+
+static CRITICAL_SECTION lock;
+static bool lock_init=false;
+static std::vector<sthread_t> threads;		//guarded by 'lock'
+static std::vector<ea_t> buffer;			//guarded by 'lock'
+
+static HANDLE process=NULL;
+static HANDLE sampler=NULL;
+static HANDLE stop_event=NULL;
+static DWORD interval;
+static int depth;
+static volatile LONG samples;
+static volatile LONG dropped;
+//-------------------------------------------------------------
+
+
+//eip and up to 'depth' return addresses of a suspended thread
+static int walk_stack(HANDLE thread, ea_t *frames)
+{
+	CONTEXT ctx;
+	DWORD frame[2];		//saved ebp, return address
+	ea_t ebp;
+	SIZE_T got;
+	int n;
+
+	ctx.ContextFlags = CONTEXT_CONTROL;
+	if( !GetThreadContext(thread, &ctx) )
+		return 0;
+
+	frames[0] = ctx.Eip;
+	ebp = ctx.Ebp;
+	for( n=1; n<=depth; n++ )
+	{
+		if( !ReadProcessMemory(process, (const void *)(size_t)ebp, frame, sizeof(frame), &got)
+			|| got != sizeof(frame) || frame[1] == 0 )
+			break;
+		frames[n] = frame[1];
+		//the caller's frame lies above ours
+		if( frame[0] <= ebp )
+		{
+			n++;
+			break;
+		}
+		ebp = frame[0];
+	}
+	return n;
+}
+
+static DWORD WINAPI sampler_proc(void * /*param*/)
+{
+	ea_t frames[SMP_MAX_DEPTH+1];
+
+	while( WaitForSingleObject(stop_event, interval) == WAIT_TIMEOUT )
+	{
+		EnterCriticalSection(&lock);
+		for( size_t i=0; i<threads.size(); i++ )
+		{
+			HANDLE h = threads[i].handle;
+			int n;
+
+			if( SuspendThread(h) == (DWORD)-1 )
+				continue;
+			n = walk_stack(h, frames);
+			ResumeThread(h);
+
+			if( n == 0 )
+				continue;
+			if( buffer.size() + n + 1 > MAX_BUFFER )
+			{
+				InterlockedIncrement(&dropped);
+				continue;
+			}
+			buffer.push_back((ea_t)n);
+			buffer.insert(buffer.end(), frames, frames + n);
+			InterlockedIncrement(&samples);
+		}
+		LeaveCriticalSection(&lock);
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+bool smp_start(int pid, int ms, int frames)
+{
+	DWORD id;
+
+	if( sampler != NULL )
+		return false;
+	if( !lock_init )
+	{
+		InitializeCriticalSection(&lock);
+		lock_init = true;
+	}
+
+	process = OpenProcess(PROCESS_VM_READ, FALSE, pid);
+	if( process == NULL )
+	{
+		msg("VSCP: could not open process %d (local debugger only).\n", pid);
+		return false;
+	}
+
+	interval = ms < 1 ? 1 : ms;
+	depth = frames < 0 ? 0 : frames > SMP_MAX_DEPTH ? SMP_MAX_DEPTH : frames;
+	samples = dropped = 0;
+	buffer.clear();
+
+	stop_event = CreateEvent(NULL, TRUE, FALSE, NULL);
+	sampler = CreateThread(NULL, 0, sampler_proc, NULL, 0, &id);
+	if( sampler == NULL )
+	{
+		CloseHandle(stop_event);
+		CloseHandle(process);
+		process = NULL;
+		return false;
+	}
+	msg("VSCP: sampling every %u ms, %d frames deep.\n", interval, depth);
+	return true;
+}
+
+void smp_add_thread(thid_t tid)
+{
+	sthread_t t;
+
+	if( sampler == NULL )
+		return;
+	t.tid = tid;
+	t.handle = OpenThread(THREAD_SUSPEND_RESUME|THREAD_GET_CONTEXT, FALSE, tid);
+	if( t.handle == NULL )
+		return;
+	EnterCriticalSection(&lock);
+	threads.push_back(t);
+	LeaveCriticalSection(&lock);
+}
+
+void smp_del_thread(thid_t tid)
+{
+	if( sampler == NULL )
+		return;
+	EnterCriticalSection(&lock);
+	for( size_t i=0; i<threads.size(); i++ )
+	{
+		if( threads[i].tid == tid )
+		{
+			CloseHandle(threads[i].handle);
+			threads.erase(threads.begin() + i);
+			break;
+		}
+	}
+	LeaveCriticalSection(&lock);
+}
+
+bool smp_active(void)
+{
+	return sampler != NULL;
+}
+//-------------------------------------------------------------
+
+
+static void frame_name(ea_t ea, char *buf, size_t bufsize)
+{
+	func_t *f = get_func(ea);
+	if( f == NULL || get_func_name(f->startEA, buf, bufsize) == NULL )
+		qsnprintf(buf, bufsize, "%08X", ea);
+}
+
+//flamegraph.pl input: "outer;..;inner count"
+static bool write_folded(const char *file)
+{
+	std::map<std::string, ulong> stacks;
+	char name[MAXSTR];
+	FILE *fp;
+	size_t i;
+
+	for( i=0; i<buffer.size(); i += buffer[i] + 1 )
+	{
+		std::string key;
+		int n = (int)buffer[i];
+		for( int j=n; j>0; j-- )
+		{
+			frame_name(buffer[i+j], name, sizeof(name));
+			if( !key.empty() )
+				key += ';';
+			key += name;
+		}
+		stacks[key]++;
+	}
+
+	fp = qfopen(file, "w");
+	if( fp == NULL )
+		return false;
+	for( std::map<std::string, ulong>::iterator p=stacks.begin(); p != stacks.end(); ++p )
+		qfprintf(fp, "%s %u\n", p->first.c_str(), p->second);
+	qfclose(fp);
+	return true;
+}
+
+//the flat profile counts the function eip was in
+static void fill_profile(void)
+{
+	eavec_t eas;
+	ulong outside = 0;
+	int i, qty;
+
+	qty = get_func_qty();
+	eas.reserve(qty);
+	for( i=0; i<qty; i++ )
+		eas.push_back(getn_func(i)->startEA);
+	prof_reset(eas);
+
+	for( size_t s=0; s<buffer.size(); s += buffer[s] + 1 )
+	{
+		func_t *f = get_func(buffer[s+1]);
+		if( f == NULL || !prof_hit(f->startEA) )
+			outside++;
+	}
+	if( outside != 0 )
+		msg("VSCP: %u samples outside of any function.\n", outside);
+}
+
+void smp_stop(const char *folded_file)
+{
+	if( sampler == NULL )
+		return;
+
+	SetEvent(stop_event);
+	WaitForSingleObject(sampler, INFINITE);
+	CloseHandle(sampler);
+	CloseHandle(stop_event);
+	sampler = NULL;
+
+	for( size_t i=0; i<threads.size(); i++ )
+		CloseHandle(threads[i].handle);
+	threads.clear();
+	CloseHandle(process);
+	process = NULL;
+
+	msg("VSCP: %u samples taken, %u dropped.\n", (ulong)samples, (ulong)dropped);
+	fill_profile();
+	if( write_folded(folded_file) )
+		msg("VSCP: collapsed stacks written to %s\n", folded_file);
+	else
+		msg("VSCP: could not write %s\n", folded_file);
+	buffer.clear();
+}
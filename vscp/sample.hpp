@@ -0,0 +1,26 @@
+// * VSCP - statistical sampling
+// *
+// * A timer thread suspends the threads of the
+// * debuggee every few milliseconds, takes EIP
+// * and a couple of return addresses from the
+// * ebp chain and lets them go again.
+// *
+
+#ifndef __SAMPLE_HPP
+#define __SAMPLE_HPP
+
+#define SMP_DEFAULT_INTERVAL	5		//ms
+#define SMP_DEFAULT_DEPTH		8		//frames
+#define SMP_MAX_DEPTH			64
+
+bool smp_start(int pid, int interval, int depth);
+void smp_add_thread(thid_t tid);
+void smp_del_thread(thid_t tid);
+
+//stops sampling, fills the profile chooser and
+//writes the collapsed stacks to 'folded_file'
+void smp_stop(const char *folded_file);
+
+bool smp_active(void);
+
+#endif // __SAMPLE_HPP
@@ -0,0 +1,375 @@
+// * VSCP - profiling scope
+// *
+// * Segments and address ranges are turned into
+// * one sorted list of disjoint intervals. IDA
+// * keeps the functions sorted by address, so the
+// * functions in scope are found by walking both
+// * lists side by side, no lookup per function.
+// * Names are only looked at for functions which
+// * passed the address test.
+// *
+// * The SDK has no regular expressions, the small
+// * matcher below knows ^ $ . [] [^] * + ? \ and
+// * alternatives separated by |, which is enough
+// * to pick functions by name.
+// *
+
+#include <algorithm>
+#include <string>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <funcs.hpp>
+#include <segment.hpp>
+#include <netnode.hpp>
+
+#include "bpts.hpp"
+#include "scope.hpp"
+
+#define SCOPE_NODE	"$ vscp scope"
+
+typedef std::vector<std::string> regex_t;	//the alternatives
+
+static std::vector<area_t> areas;	//sorted, disjoint
+static bool all_areas=true;
+static regex_t include, exclude;
+static short flags=0;
+//-------------------------------------------------------------
+
+
+//returns the end of the atom at 're' or NULL if it is broken
+static const char *atom_end(const char *re)
+{
+	const char *p;
+
+	if( *re == '\\' )
+		return re[1] != '\0' ? re + 2 : NULL;
+	if( *re != '[' )
+		return re + 1;
+	p = re + 1;
+	if( *p == '^' )
+		p++;
+	//a leading ] is a literal
+	if( *p == ']' )
+		p++;
+	while( *p != '\0' && *p != ']' )
+		p++;
+	return *p == ']' ? p + 1 : NULL;
+}
+
+static bool atom_match(const char *re, char c)
+{
+	const char *p;
+	bool neg, hit;
+
+	switch( *re )
+	{
+	case '\\':
+		return re[1] == c;
+	case '.':
+		return true;
+	case '[':
+		p = re + 1;
+		neg = *p == '^';
+		if( neg )
+			p++;
+		hit = false;
+		do
+		{
+			if( p[1] == '-' && p[2] != ']' )
+			{
+				if( c >= p[0] && c <= p[2] )
+					hit = true;
+				p += 3;
+			}
+			else if( *p++ == c )
+				hit = true;
+		} while( *p != ']' );
+		return hit != neg;
+	}
+	return *re == c;
+}
+
+static bool match_here(const char *re, const char *end, const char *text)
+{
+	const char *next;
+	size_t n, k, min, max;
+	char q;
+
+	if( re == end )
+		return true;
+	if( *re == '$' && re + 1 == end )
+		return *text == '\0';
+
+	next = atom_end(re);
+	q = next < end ? *next : '\0';
+	if( q != '*' && q != '+' && q != '?' )
+		return *text != '\0' && atom_match(re, *text) && match_here(next, end, text + 1);
+
+	//greedy, then back off
+	min = q == '+' ? 1 : 0;
+	max = q == '?' ? 1 : (size_t)-1;
+	for( n=0; n < max && text[n] != '\0' && atom_match(re, text[n]); n++ )
+		;
+	for( k=n+1; k-- > min; )
+	{
+		if( match_here(next + 1, end, text + k) )
+			return true;
+	}
+	return false;
+}
+
+static bool regex_match(const regex_t &rx, const char *text)
+{
+	for( size_t i=0; i<rx.size(); i++ )
+	{
+		const char *re = rx[i].c_str();
+		const char *end = re + rx[i].size();
+		const char *t = text;
+
+		if( *re == '^' )
+		{
+			if( match_here(re + 1, end, t) )
+				return true;
+			continue;
+		}
+		do
+		{
+			if( match_here(re, end, t) )
+				return true;
+		} while( *t++ != '\0' );
+	}
+	return false;
+}
+
+//splits 'src' into its alternatives and checks them
+static bool regex_compile(const char *src, regex_t &rx)
+{
+	const char *p, *next, *start;
+
+	rx.clear();
+	start = p = src;
+	while( true )
+	{
+		if( *p == '|' || *p == '\0' )
+		{
+			rx.push_back(std::string(start, p));
+			if( *p == '\0' )
+				break;
+			start = ++p;
+			continue;
+		}
+		if( p == start && *p == '^' )
+		{
+			p++;
+			continue;
+		}
+		if( *p == '*' || *p == '+' || *p == '?' )
+		{
+			msg("VSCP: nothing to repeat in \"%s\"\n", src);
+			return false;
+		}
+		next = atom_end(p);
+		if( next == NULL )
+		{
+			msg("VSCP: unterminated [ or \\ in \"%s\"\n", src);
+			return false;
+		}
+		if( *next == '*' || *next == '+' || *next == '?' )
+			next++;
+		p = next;
+	}
+	return true;
+}
+//-------------------------------------------------------------
+
+
+static bool area_cmp(const area_t &a, const area_t &b)
+{
+	return a.startEA < b.startEA;
+}
+
+static void add_area(ea_t start, ea_t end)
+{
+	area_t a;
+	a.startEA = start;
+	a.endEA = end;
+	areas.push_back(a);
+}
+
+static bool is_sep(char c)
+{
+	return c == ' ' || c == ',' || c == ';' || c == '\t';
+}
+
+static bool parse_segments(const char *list)
+{
+	char name[MAXSTR];
+	const char *p = list;
+	size_t len;
+	int i, found;
+
+	while( *p != '\0' )
+	{
+		while( is_sep(*p) )
+			p++;
+		for( len=0; p[len] != '\0' && !is_sep(p[len]); len++ )
+			;
+		if( len == 0 )
+			break;
+		std::string wanted(p, len);
+		p += len;
+
+		//the same name may be used by several segments
+		found = 0;
+		for( i=0; i<get_segm_qty(); i++ )
+		{
+			segment_t *s = getnseg(i);
+			if( get_segm_name(s, name, sizeof(name)) > 0 && wanted == name )
+			{
+				add_area(s->startEA, s->endEA);
+				found++;
+			}
+		}
+		if( found == 0 )
+		{
+			msg("VSCP: there is no segment %s\n", wanted.c_str());
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool parse_ranges(const char *list)
+{
+	const char *p = list;
+	char *q;
+	ea_t start, end;
+
+	while( true )
+	{
+		while( is_sep(*p) )
+			p++;
+		if( *p == '\0' )
+			break;
+		start = (ea_t)strtoul(p, &q, 16);
+		if( q == p || *q != '-' )
+		{
+			msg("VSCP: bad address range at \"%s\", use start-end\n", p);
+			return false;
+		}
+		p = q + 1;
+		end = (ea_t)strtoul(p, &q, 16);
+		if( q == p || end <= start )
+		{
+			msg("VSCP: bad address range at \"%s\"\n", p);
+			return false;
+		}
+		p = q;
+		add_area(start, end);
+	}
+	return true;
+}
+//-------------------------------------------------------------
+
+
+void scope_load(scope_t &s)
+{
+	netnode n(SCOPE_NODE);
+
+	memset(&s, 0, sizeof(s));
+	if( n == BADNODE )
+		return;
+	n.supstr(0, s.segments, sizeof(s.segments));
+	n.supstr(1, s.ranges, sizeof(s.ranges));
+	n.supstr(2, s.include, sizeof(s.include));
+	n.supstr(3, s.exclude, sizeof(s.exclude));
+	s.flags = (short)n.altval(0);
+}
+
+void scope_save(const scope_t &s)
+{
+	netnode n;
+	n.create(SCOPE_NODE);
+	n.supset(0, s.segments);
+	n.supset(1, s.ranges);
+	n.supset(2, s.include);
+	n.supset(3, s.exclude);
+	n.altset(0, s.flags);
+}
+
+bool scope_build(const scope_t &s)
+{
+	size_t i, j;
+
+	areas.clear();
+	if( !parse_segments(s.segments) || !parse_ranges(s.ranges) )
+		return false;
+	if( !regex_compile(s.include, include) || !regex_compile(s.exclude, exclude) )
+		return false;
+	//an empty pattern would match everything
+	if( s.include[0] == '\0' )
+		include.clear();
+	if( s.exclude[0] == '\0' )
+		exclude.clear();
+	flags = s.flags;
+
+	//neither segments nor ranges: everything
+	all_areas = areas.empty();
+	std::sort(areas.begin(), areas.end(), area_cmp);
+	for( i=j=0; i<areas.size(); i++ )
+	{
+		if( j > 0 && areas[i].startEA <= areas[j-1].endEA )
+			areas[j-1].endEA = qmax(areas[j-1].endEA, areas[i].endEA);
+		else
+			areas[j++] = areas[i];
+	}
+	areas.resize(j);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+static bool func_in_scope(func_t *f)
+{
+	char name[MAXSTR];
+
+	if( (flags & SCOPE_SKIP_LIB) != 0 && (f->flags & FUNC_LIB) != 0 )
+		return false;
+	if( include.empty() && exclude.empty() )
+		return true;
+	if( get_func_name(f->startEA, name, sizeof(name)) == NULL )
+		name[0] = '\0';
+	if( !include.empty() && !regex_match(include, name) )
+		return false;
+	return exclude.empty() || !regex_match(exclude, name);
+}
+
+size_t scope_collect(eavec_t &eas)
+{
+	size_t i, k, qty, n;
+
+	qty = get_func_qty();
+	n = 0;
+	k = 0;
+	for( i=0; i<qty; i++ )
+	{
+		func_t *f = getn_func(i);
+		if( !all_areas )
+		{
+			while( k < areas.size() && areas[k].endEA <= f->startEA )
+				k++;
+			if( k == areas.size() )
+				break;
+			if( f->startEA < areas[k].startEA )
+				continue;
+		}
+		if( func_in_scope(f) )
+		{
+			eas.push_back(f->startEA);
+			n++;
+		}
+	}
+	return n;
+}
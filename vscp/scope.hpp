@@ -0,0 +1,34 @@
+// * VSCP - profiling scope
+// *
+// * Restricts the breakpoints to the functions
+// * we are interested in: by segment, by address
+// * range and by name.
+// *
+
+#ifndef __SCOPE_HPP
+#define __SCOPE_HPP
+
+#define SCOPE_SKIP_LIB		0x0001	//no library (FLIRT) functions
+
+struct scope_t
+{
+	char segments[MAXSTR];	//segment names, separated by spaces or commas
+	char ranges[MAXSTR];	//"start-end, ..." in hex, end exclusive
+	char include[MAXSTR];	//regex, function names must match
+	char exclude[MAXSTR];	//regex, function names must not match
+	short flags;
+};
+
+//the scope is kept in the database
+void scope_load(scope_t &s);
+void scope_save(const scope_t &s);
+
+//compiles the scope, returns false (and explains why) if a
+//range or a regex is broken
+bool scope_build(const scope_t &s);
+
+//appends the entries of all functions in scope to 'eas'
+//and returns their number
+size_t scope_collect(eavec_t &eas);
+
+#endif // __SCOPE_HPP
@@ -0,0 +1,158 @@
+// * VSCP - inclusive/exclusive time
+// *
+// * Every frame remembers esp at the function
+// * entry, i.e. the address of its return address.
+// * Frames are matched by the stack pointer alone,
+// * not by the return site:
+// *
+// * - at a return site, esp has moved above the
+// *   entry esp of the frame that returned, so all
+// *   frames with entry esp < esp are finished
+// * - at a function entry, frames with entry esp
+// *   <= esp can't be alive anymore either
+// *
+// * This way frames which never saw their return
+// * breakpoint (longjmp, exceptions, a return site
+// * with a user breakpoint) are closed at the next
+// * event above them.
+// *
+// * Times include the breakpoint overhead of the
+// * callees, so they are good for comparing
+// * functions rather than as absolute numbers.
+// *
+
+#include <windows.h>
+
+#include <map>
+#include <set>
+
+#include <ida.hpp>
+#include <idp.hpp>
+#include <kernwin.hpp>
+#include <dbg.hpp>
+#include <funcs.hpp>
+
+#include "profile.hpp"
+#include "callgraph.hpp"
+#include "timing.hpp"
+
+struct frame_t
+{
+	ea_t func;
+	ea_t esp;			//at the entry, points to the return address
+	uint64 start;		//ticks
+	uint64 children;	//ticks spent in callees
+};
+
+typedef std::vector<frame_t> shadow_stack_t;
+
+static std::map<thid_t, shadow_stack_t> stacks;
+static std::set<ea_t> return_sites;
+//-------------------------------------------------------------
+
+
+static uint64 now(void)
+{
+	LARGE_INTEGER li;
+	QueryPerformanceCounter(&li);
+	return li.QuadPart;
+}
+
+//pops all frames with an entry esp below 'limit' (or equal
+//to it, if 'inclusive' is set)
+static void unwind(shadow_stack_t &st, ea_t limit, bool inclusive, uint64 t)
+{
+	while( !st.empty() )
+	{
+		frame_t &f = st.back();
+		if( inclusive ? f.esp > limit : f.esp >= limit )
+			break;
+
+		uint64 incl = t - f.start;
+		uint64 excl = incl > f.children ? incl - f.children : 0;
+		prof_leave(f.func, incl, excl);
+		st.pop_back();
+		if( !st.empty() )
+			st.back().children += incl;
+	}
+}
+//-------------------------------------------------------------
+
+
+void tm_reset(void)
+{
+	stacks.clear();
+	return_sites.clear();
+}
+
+bool tm_event(thid_t tid, ea_t ea, bool entry, bool callers)
+{
+	uint64 t = now();
+	regval_t esp;
+	uint32 ret;
+	bool is_return;
+
+	is_return = return_sites.find(ea) != return_sites.end();
+	if( !entry && !is_return )
+		return false;
+	if( !get_reg_val("esp", &esp) )
+		return true;
+
+	shadow_stack_t &st = stacks[tid];
+	if( is_return )
+		unwind(st, (ea_t)esp.ival, false, t);
+	if( !entry )
+		return true;
+
+	unwind(st, (ea_t)esp.ival, true, t);
+
+	if( read_dbg_memory((ea_t)esp.ival, &ret, sizeof(ret)) == sizeof(ret) )
+	{
+		if( callers )
+		{
+			func_t *f = get_func(ret);
+			cg_add(f != NULL ? f->startEA : CG_EXTERNAL, ea);
+		}
+		//first call from this site: catch the return, unless
+		//the user has a breakpoint there, which is left alone
+		if( return_sites.find(ret) == return_sites.end() &&
+			(bpts_add_one(ret, BPT_TRACE) || bpts_owned(ret)) )
+		{
+			return_sites.insert(ret);
+		}
+	}
+
+	frame_t f;
+	f.func = ea;
+	f.esp = (ea_t)esp.ival;
+	f.children = 0;
+	prof_enter(ea);
+	//don't charge our own overhead to the new frame
+	f.start = now();
+	st.push_back(f);
+	return true;
+}
+//-------------------------------------------------------------
+
+
+void tm_thread_exit(thid_t tid)
+{
+	std::map<thid_t, shadow_stack_t>::iterator p = stacks.find(tid);
+	if( p == stacks.end() )
+		return;
+	unwind(p->second, BADADDR, true, now());
+	stacks.erase(p);
+}
+
+void tm_stop(void)
+{
+	uint64 t = now();
+	for( std::map<thid_t, shadow_stack_t>::iterator p=stacks.begin(); p != stacks.end(); ++p )
+		unwind(p->second, BADADDR, true, t);
+	stacks.clear();
+}
+
+size_t tm_return_sites(void)
+{
+	return return_sites.size();
+}
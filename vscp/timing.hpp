@@ -0,0 +1,25 @@
+// * VSCP - inclusive/exclusive time
+// *
+// * Keeps a shadow stack per thread. Function
+// * entries push a frame and get a breakpoint on
+// * their return site, hits at a return site pop
+// * the frames that have been left.
+// *
+
+#ifndef __TIMING_HPP
+#define __TIMING_HPP
+
+void tm_reset(void);
+
+//handles a VSCP breakpoint hit in timing mode, 'entry' is
+//set if 'ea' is the start of a profiled function.
+//returns false if 'ea' is neither an entry nor a return site
+bool tm_event(thid_t tid, ea_t ea, bool entry, bool callers);
+
+//closes all frames of a thread / of all threads
+void tm_thread_exit(thid_t tid);
+void tm_stop(void);
+
+size_t tm_return_sites(void);
+
+#endif // __TIMING_HPP
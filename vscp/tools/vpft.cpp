@@ -0,0 +1,163 @@
+// * vpft - VSCP profile tool
+// *
+// * Merges and compares the .vpf profiles VSCP
+// * writes at the end of every run, without IDA.
+// * Meant for large numbers of runs (fuzz corpora):
+// * all files are sorted by address, so merging is
+// * a single k-way merge over the inputs.
+// *
+// * Build (Linux):
+// *   g++ -O2 -o vpft vpft.cpp
+// *
+// * Usage:
+// *   vpft info  <file>
+// *   vpft dump  <file>
+// *   vpft merge <out> <in> [in ...]
+// *   vpft diff  <a> <b> [factor]
+// *
+// * 'diff' lists the functions whose hits per run
+// * changed by at least 'factor' (default 2),
+// * functions which ran on one side only first.
+// *
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "../vpf.hpp"
+
+typedef unsigned long long u64;
+//-------------------------------------------------------------
+
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: vpft info  <file>\n"
+		"       vpft dump  <file>\n"
+		"       vpft merge <out> <in> [in ...]\n"
+		"       vpft diff  <a> <b> [factor]\n");
+}
+
+static bool load(const char *file, vpf_header_t &h, std::vector<vpf_record_t> &recs)
+{
+	if( vpf_load(file, h, recs) )
+		return true;
+	fprintf(stderr, "vpft: %s is not a profile\n", file);
+	return false;
+}
+//-------------------------------------------------------------
+
+
+static int cmd_info(const char *file)
+{
+	std::vector<vpf_record_t> recs;
+	vpf_header_t h;
+	u64 hits = 0;
+
+	if( !load(file, h, recs) )
+		return 1;
+	for( size_t i=0; i<recs.size(); i++ )
+		hits += recs[i].hits;
+
+	printf("functions %u\nruns      %u\nhits      %llu\ntimed     %s\nmd5       ",
+		h.count, h.runs, hits, (h.flags & VPF_FLAG_TIMED) ? "yes" : "no");
+	for( int i=0; i<16; i++ )
+		printf("%02x", h.md5[i]);
+	printf("\n");
+	return 0;
+}
+
+static int cmd_dump(const char *file)
+{
+	std::vector<vpf_record_t> recs;
+	vpf_header_t h;
+
+	if( !load(file, h, recs) )
+		return 1;
+	printf("address   name_hash  hits                 incl_us              excl_us\n");
+	for( size_t i=0; i<recs.size(); i++ )
+	{
+		const vpf_record_t &r = recs[i];
+		printf("%08X  %08X  %-20llu %-20llu %llu\n",
+			r.ea, r.name_hash, (u64)r.hits, (u64)r.incl_us, (u64)r.excl_us);
+	}
+	return 0;
+}
+
+static int cmd_merge(const char *out, int n, char **in)
+{
+	std::vector<std::string> files(in, in + n);
+	std::string err;
+
+	if( !vpf_merge_files(files, out, err) )
+	{
+		fprintf(stderr, "vpft: %s\n", err.c_str());
+		return 1;
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+static bool ratio_cmp(const vpf_diff_t &a, const vpf_diff_t &b)
+{
+	if( a.ratio != b.ratio )
+		return a.ratio > b.ratio;
+	return a.ea < b.ea;
+}
+
+static int cmd_diff(const char *fa, const char *fb, double factor)
+{
+	std::vector<vpf_record_t> a, b;
+	std::vector<vpf_diff_t> d;
+	vpf_header_t ha, hb;
+
+	if( !load(fa, ha, a) || !load(fb, hb, b) )
+		return 1;
+	if( memcmp(ha.md5, hb.md5, 16) != 0 )
+		fprintf(stderr, "vpft: warning, the profiles belong to different input files\n");
+
+	vpf_diff(ha, a, hb, b, factor, d);
+	std::sort(d.begin(), d.end(), ratio_cmp);
+
+	printf("address   hits_a               hits_b               change\n");
+	for( size_t i=0; i<d.size(); i++ )
+	{
+		printf("%08X  %-20llu %-20llu ", d[i].ea, (u64)d[i].hits_a, (u64)d[i].hits_b);
+		if( d[i].hits_a == 0 )
+			printf("new\n");
+		else if( d[i].hits_b == 0 )
+			printf("gone\n");
+		else
+			printf("%.2fx\n", d[i].ratio);
+	}
+	return 0;
+}
+//-------------------------------------------------------------
+
+
+int main(int argc, char *argv[])
+{
+	if( argc < 3 )
+	{
+		usage();
+		return 1;
+	}
+
+	const char *cmd = argv[1];
+
+	if( strcmp(cmd, "info") == 0 )
+		return cmd_info(argv[2]);
+	if( strcmp(cmd, "dump") == 0 )
+		return cmd_dump(argv[2]);
+	if( strcmp(cmd, "merge") == 0 && argc > 3 )
+		return cmd_merge(argv[2], argc - 3, argv + 3);
+	if( strcmp(cmd, "diff") == 0 && argc > 3 )
+		return cmd_diff(argv[2], argv[3], argc > 4 ? atof(argv[4]) : 2.0);
+
+	usage();
+	return 1;
+}
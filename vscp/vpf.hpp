@@ -0,0 +1,432 @@
+// * VSCP - profile file format (.vpf)
+// *
+// * A profile file is a 48 byte header followed by
+// * fixed size records, sorted by address:
+// *
+// *   header:  char    magic[8]    "VSCPPROF"
+// *            u32     version
+// *            u32     flags
+// *            u32     number of records
+// *            u32     number of runs merged into the file
+// *            u8      md5[16]     of the input file
+// *            u8      reserved[8]
+// *
+// *   record:  u32     function address
+// *            u32     FNV-1a hash of the function name
+// *            u64     hits
+// *            u64     inclusive time in microseconds
+// *            u64     exclusive time in microseconds
+// *
+// * All integers are stored little endian. Since
+// * every file is sorted, merging N runs is a single
+// * k-way merge and diffing two runs a merge join.
+// * This header is shared by the plugin and the
+// * offline tool (tools/vpft.cpp), so it must not
+// * depend on the IDA SDK.
+// *
+
+#ifndef __VPF_HPP
+#define __VPF_HPP
+
+#include <stdio.h>
+#include <string.h>
+
+#include <vector>
+#include <string>
+#include <queue>
+
+typedef unsigned char vpf_u8;
+typedef unsigned int vpf_u32;
+typedef unsigned long long vpf_u64;
+
+#define VPF_MAGIC		"VSCPPROF"
+#define VPF_VERSION		1
+#define VPF_FLAG_TIMED	0x0001		//records carry times
+
+#define VPF_HDR_SIZE	48
+#define VPF_REC_SIZE	32
+
+//files merged at once, more are merged in several passes
+#define VPF_MAX_OPEN	256
+
+struct vpf_header_t
+{
+	vpf_u32 version;
+	vpf_u32 flags;
+	vpf_u32 count;
+	vpf_u32 runs;
+	vpf_u8 md5[16];
+};
+
+struct vpf_record_t
+{
+	vpf_u32 ea;
+	vpf_u32 name_hash;
+	vpf_u64 hits;
+	vpf_u64 incl_us;
+	vpf_u64 excl_us;
+};
+
+//-------------------------------------------------------------
+
+static inline vpf_u32 vpf_name_hash(const char *name)
+{
+	vpf_u32 h = 2166136261u;
+	while( *name != '\0' )
+		h = (h ^ (vpf_u8)*name++) * 16777619u;
+	return h;
+}
+
+static inline void vpf_put32(vpf_u8 *p, vpf_u32 v)
+{
+	p[0] = (vpf_u8)v; p[1] = (vpf_u8)(v >> 8);
+	p[2] = (vpf_u8)(v >> 16); p[3] = (vpf_u8)(v >> 24);
+}
+
+static inline vpf_u32 vpf_get32(const vpf_u8 *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((vpf_u32)p[3] << 24);
+}
+
+static inline void vpf_put64(vpf_u8 *p, vpf_u64 v)
+{
+	vpf_put32(p, (vpf_u32)v);
+	vpf_put32(p + 4, (vpf_u32)(v >> 32));
+}
+
+static inline vpf_u64 vpf_get64(const vpf_u8 *p)
+{
+	return vpf_get32(p) | ((vpf_u64)vpf_get32(p + 4) << 32);
+}
+
+//-------------------------------------------------------------
+
+static inline bool vpf_write_header(FILE *fp, const vpf_header_t &h)
+{
+	vpf_u8 buf[VPF_HDR_SIZE];
+
+	memset(buf, 0, sizeof(buf));
+	memcpy(buf, VPF_MAGIC, 8);
+	vpf_put32(buf + 8, h.version);
+	vpf_put32(buf + 12, h.flags);
+	vpf_put32(buf + 16, h.count);
+	vpf_put32(buf + 20, h.runs);
+	memcpy(buf + 24, h.md5, 16);
+	return fwrite(buf, 1, sizeof(buf), fp) == sizeof(buf);
+}
+
+static inline bool vpf_read_header(FILE *fp, vpf_header_t &h)
+{
+	vpf_u8 buf[VPF_HDR_SIZE];
+
+	if( fread(buf, 1, sizeof(buf), fp) != sizeof(buf) || memcmp(buf, VPF_MAGIC, 8) != 0 )
+		return false;
+	h.version = vpf_get32(buf + 8);
+	h.flags = vpf_get32(buf + 12);
+	h.count = vpf_get32(buf + 16);
+	h.runs = vpf_get32(buf + 20);
+	memcpy(h.md5, buf + 24, 16);
+	return h.version == VPF_VERSION;
+}
+
+static inline bool vpf_write_record(FILE *fp, const vpf_record_t &r)
+{
+	vpf_u8 buf[VPF_REC_SIZE];
+
+	vpf_put32(buf, r.ea);
+	vpf_put32(buf + 4, r.name_hash);
+	vpf_put64(buf + 8, r.hits);
+	vpf_put64(buf + 16, r.incl_us);
+	vpf_put64(buf + 24, r.excl_us);
+	return fwrite(buf, 1, sizeof(buf), fp) == sizeof(buf);
+}
+
+static inline bool vpf_read_record(FILE *fp, vpf_record_t &r)
+{
+	vpf_u8 buf[VPF_REC_SIZE];
+
+	if( fread(buf, 1, sizeof(buf), fp) != sizeof(buf) )
+		return false;
+	r.ea = vpf_get32(buf);
+	r.name_hash = vpf_get32(buf + 4);
+	r.hits = vpf_get64(buf + 8);
+	r.incl_us = vpf_get64(buf + 16);
+	r.excl_us = vpf_get64(buf + 24);
+	return true;
+}
+
+//-------------------------------------------------------------
+
+//writes a whole profile, 'recs' must be sorted by address
+static inline bool vpf_save(const char *file, const vpf_header_t &hdr,
+							const std::vector<vpf_record_t> &recs)
+{
+	FILE *fp = fopen(file, "wb");
+	vpf_header_t h = hdr;
+	bool ok;
+
+	if( fp == NULL )
+		return false;
+	h.count = (vpf_u32)recs.size();
+	ok = vpf_write_header(fp, h);
+	for( size_t i=0; ok && i<recs.size(); i++ )
+		ok = vpf_write_record(fp, recs[i]);
+	return fclose(fp) == 0 && ok;
+}
+
+static inline bool vpf_load(const char *file, vpf_header_t &h,
+							std::vector<vpf_record_t> &recs)
+{
+	FILE *fp = fopen(file, "rb");
+	bool ok;
+
+	if( fp == NULL )
+		return false;
+	ok = vpf_read_header(fp, h);
+	recs.clear();
+	if( ok )
+	{
+		recs.resize(h.count);
+		for( vpf_u32 i=0; ok && i<h.count; i++ )
+			ok = vpf_read_record(fp, recs[i]);
+	}
+	fclose(fp);
+	return ok;
+}
+
+//-------------------------------------------------------------
+
+//one input of a k-way merge
+struct vpf_stream_t
+{
+	FILE *fp;
+	vpf_u32 left;
+	vpf_record_t cur;
+
+	bool next(void)
+	{
+		if( left == 0 || !vpf_read_record(fp, cur) )
+			return false;
+		left--;
+		return true;
+	}
+};
+
+struct vpf_stream_cmp
+{
+	bool operator()(const vpf_stream_t *a, const vpf_stream_t *b) const
+	{
+		return a->cur.ea > b->cur.ea;		//min heap
+	}
+};
+
+//merges already opened profiles (positioned after their
+//header) into 'out'. Hits and times are summed up.
+static inline bool vpf_merge_streams(std::vector<vpf_stream_t> &in,
+									 FILE *out, vpf_header_t &h)
+{
+	std::priority_queue<vpf_stream_t *, std::vector<vpf_stream_t *>, vpf_stream_cmp> heap;
+	vpf_record_t acc;
+	bool have = false;
+	size_t i;
+
+	h.count = 0;
+	if( !vpf_write_header(out, h) )
+		return false;
+
+	for( i=0; i<in.size(); i++ )
+	{
+		if( in[i].next() )
+			heap.push(&in[i]);
+	}
+
+	while( !heap.empty() )
+	{
+		vpf_stream_t *s = heap.top();
+		heap.pop();
+
+		if( have && acc.ea == s->cur.ea )
+		{
+			acc.hits += s->cur.hits;
+			acc.incl_us += s->cur.incl_us;
+			acc.excl_us += s->cur.excl_us;
+		}
+		else
+		{
+			if( have )
+			{
+				if( !vpf_write_record(out, acc) )
+					return false;
+				h.count++;
+			}
+			acc = s->cur;
+			have = true;
+		}
+		if( s->next() )
+			heap.push(s);
+	}
+	if( have )
+	{
+		if( !vpf_write_record(out, acc) )
+			return false;
+		h.count++;
+	}
+
+	//now that the number of records is known
+	fseek(out, 0, SEEK_SET);
+	return vpf_write_header(out, h) && fflush(out) == 0;
+}
+
+//merges any number of profile files into 'outfile'. All
+//inputs must have the same md5 (an all zero md5 matches
+//anything). On failure 'err' says why.
+static inline bool vpf_merge_files(const std::vector<std::string> &files,
+								   const char *outfile, std::string &err)
+{
+	std::vector<vpf_stream_t> in;
+	vpf_header_t h, first;
+	FILE *carry = NULL;		//result of the previous pass
+	static const vpf_u8 nomd5[16] = { 0 };
+	size_t pos = 0;
+	bool ok = true;
+
+	memset(&first, 0, sizeof(first));
+	first.version = VPF_VERSION;
+
+	if( files.empty() )
+	{
+		err = "no input files";
+		return false;
+	}
+
+	while( ok && pos < files.size() )
+	{
+		in.clear();
+		if( carry != NULL )
+		{
+			vpf_stream_t s;
+			fseek(carry, 0, SEEK_SET);
+			vpf_read_header(carry, h);
+			s.fp = carry;
+			s.left = h.count;
+			in.push_back(s);
+		}
+
+		//open the next batch
+		for( ; pos < files.size() && in.size() < VPF_MAX_OPEN; pos++ )
+		{
+			vpf_stream_t s;
+			s.fp = fopen(files[pos].c_str(), "rb");
+			if( s.fp == NULL || !vpf_read_header(s.fp, h) )
+			{
+				err = files[pos] + ": not a profile";
+				if( s.fp != NULL )
+					fclose(s.fp);
+				ok = false;
+				break;
+			}
+			if( first.runs == 0 )
+			{
+				memcpy(first.md5, h.md5, 16);
+				first.flags = h.flags;
+			}
+			else if( memcmp(h.md5, nomd5, 16) != 0 && memcmp(first.md5, nomd5, 16) != 0
+				&& memcmp(h.md5, first.md5, 16) != 0 )
+			{
+				err = files[pos] + ": profile of a different input file";
+				fclose(s.fp);
+				ok = false;
+				break;
+			}
+			first.flags |= h.flags;
+			first.runs += h.runs;
+			s.left = h.count;
+			in.push_back(s);
+		}
+
+		FILE *out = NULL;
+		if( ok )
+		{
+			out = pos < files.size() ? tmpfile() : fopen(outfile, "w+b");
+			if( out == NULL )
+			{
+				err = "can't create the output file";
+				ok = false;
+			}
+		}
+		if( ok )
+		{
+			h = first;
+			ok = vpf_merge_streams(in, out, h);
+			if( !ok )
+				err = "write error";
+		}
+
+		for( size_t i=0; i<in.size(); i++ )
+			fclose(in[i].fp);
+		carry = out;
+	}
+	if( carry != NULL )
+	{
+		if( fclose(carry) != 0 && ok )
+		{
+			err = "write error";
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+//-------------------------------------------------------------
+
+struct vpf_diff_t
+{
+	vpf_u32 ea;
+	vpf_u64 hits_a;
+	vpf_u64 hits_b;
+	double ratio;		//>= 1, larger count / smaller count
+};
+
+//compares the hits of two profiles (merge join), both
+//sides are normalized to the number of runs. Functions
+//whose counts differ by at least 'factor' end up in 'out'.
+//A function missing on one side counts as an infinite change.
+static inline void vpf_diff(const vpf_header_t &ha, const std::vector<vpf_record_t> &a,
+							const vpf_header_t &hb, const std::vector<vpf_record_t> &b,
+							double factor, std::vector<vpf_diff_t> &out)
+{
+	double na = ha.runs != 0 ? ha.runs : 1;
+	double nb = hb.runs != 0 ? hb.runs : 1;
+	size_t i = 0, j = 0;
+
+	out.clear();
+	while( i < a.size() || j < b.size() )
+	{
+		vpf_diff_t d;
+		if( j == b.size() || (i < a.size() && a[i].ea < b[j].ea) )
+		{
+			d.ea = a[i].ea; d.hits_a = a[i].hits; d.hits_b = 0; i++;
+		}
+		else if( i == a.size() || b[j].ea < a[i].ea )
+		{
+			d.ea = b[j].ea; d.hits_a = 0; d.hits_b = b[j].hits; j++;
+		}
+		else
+		{
+			d.ea = a[i].ea; d.hits_a = a[i].hits; d.hits_b = b[j].hits; i++; j++;
+		}
+
+		double x = d.hits_a / na;
+		double y = d.hits_b / nb;
+		if( x == y )
+			continue;
+		if( x == 0 || y == 0 )
+			d.ratio = 1e300;
+		else
+			d.ratio = x > y ? x / y : y / x;
+		if( d.ratio >= factor )
+			out.push_back(d);
+	}
+}
+
+#endif // __VPF_HPP
@@ -3,9 +3,43 @@
 // * This plugin shows you how often a function
 // * during a runtime debugging session is called.
 // *
+// * Alt-8 opens the command dialog, run it with
+// * argument 1 (see plugins.cfg) to go straight to
+// * the profile:
+// *   VSCP_profile  vscp  Alt-Shift-8  1
+// *
 // * This code is (C) by Dennis Elser
 // *
+// * 19.10.2026: breakpoints are installed and removed
+// *             in one batch (see bpts.cpp), user
+// *             breakpoints are left alone
+// *             hits are counted per function and shown
+// *             in a sorted chooser (see profile.cpp)
+// *             coverage mode with one-shot breakpoints,
+// *             export and coloring (see cover.cpp)
+// *             statistical sampling mode, flat profile
+// *             and collapsed stacks (see sample.cpp)
+// *             dynamic call graph with edge counts, DOT/GML
+// *             export and graph viewer (see callgraph.cpp),
+// *             replaces dbgext/callgraph.idc
+// *             timing mode: return site breakpoints and
+// *             shadow stacks give inclusive/exclusive
+// *             time per function (see timing.cpp)
+// *             every run is saved as a .vpf profile,
+// *             profiles can be loaded, merged and
+// *             compared (see runs.cpp, tools/vpft.cpp)
+// *             breakpoints only for the functions in scope:
+// *             segments, address ranges and name filters
+// *             (see scope.cpp)
+// *             basic block coverage with drcov export
+// *             (see bbcov.cpp)
+// *             log-scaled heatmap of the profile in the
+// *             disassembly and the graphtest2 flowgraph
+// *             (see heat.cpp)
+// *
+
 
+#include <windows.h>
 
 #include <ida.hpp>
 #include <idp.hpp>
@@ -15,60 +49,305 @@
 #include <dbg.hpp>
 #include <funcs.hpp>
 
+#include "bpts.hpp"
+#include "profile.hpp"
+#include "cover.hpp"
+#include "bbcov.hpp"
+#include "heat.hpp"
+#include "sample.hpp"
+#include "callgraph.hpp"
+#include "timing.hpp"
+#include "runs.hpp"
+#include "scope.hpp"
+
+//how often the profile chooser is refreshed while the process runs
+#define REFRESH_INTERVAL	1000	//ms
+
+//profiling modes, same order as the radio buttons
+enum
+{
+	MODE_HITS,
+	MODE_COVER,
+	MODE_BLOCKS,
+	MODE_SAMPLE,
+	MODE_TIME
+};
+
+//commands of run(), same order as the radio buttons
+enum
+{
+	CMD_PROFILE,
+	CMD_COVER_EXPORT,
+	CMD_COVER_PAINT,
+	CMD_COVER_UNPAINT,
+	CMD_BLOCKS_EXPORT,
+	CMD_HEAT_PAINT,
+	CMD_HEAT_UNPAINT,
+	CMD_CALLGRAPH,
+	CMD_CALLGRAPH_EXPORT,
+	CMD_SAVE,
+	CMD_LOAD,
+	CMD_MERGE,
+	CMD_DIFF,
+	CMD_DELETE
+};
+
+const char start_dlg[] =
+	"STARTITEM 0\n"
+	"VSCP\n"
+	"VSCP - Want to profile the process?\n\n"
+	"<#Counts every call of every function.#"
+	"Count function hits:R>\n"
+	"<#Every breakpoint removes itself on its first hit.#"
+	"Function coverage:R>\n"
+	"<#Like function coverage, but with a breakpoint on every basic block.#"
+	"Basic block coverage:R>\n"
+	"<#No breakpoints, the threads are sampled by a timer.#"
+	"Statistical sampling:R>\n"
+	"<#Also sets breakpoints on return sites to measure inclusive and exclusive time.#"
+	"Count hits and time functions:R>>\n\n"
+	"<#Milliseconds between two samples.#"
+	"Sample interval (ms) :D:4:4::>\n"
+	"<#Return addresses taken from the ebp chain, 0 = flat profile only.#"
+	"Stack depth          :D:4:4::>\n\n"
+	"<#Reads the return address at every hit to find the calling function.#"
+	"Record callers (call graph):C>>\n\n"
+	"Scope (breakpoints only, empty = everything)\n"
+	"<#Segment names separated by spaces, e.g. .text#"
+	"Segments     :A:255:32::>\n"
+	"<#Hex start-end pairs separated by commas, the end is not included.#"
+	"Ranges       :A:255:32::>\n"
+	"<#Regular expression, e.g. ^sub_|Decrypt#"
+	"Names        :A:255:32::>\n"
+	"<#Regular expression, e.g. ^_|crt#"
+	"Except names :A:255:32::>\n"
+	"<#Leaves out the functions FLIRT recognized as library code.#"
+	"Skip library functions:C>>\n\n"
+	;
+
+const char cmd_dlg[] =
+	"STARTITEM 0\n"
+	"VSCP\n"
+	"Very Simple Code Profiling\n\n"
+	"<#Shows the hit counts of the last run.#"
+	"Show profile:R>\n"
+	"<#Writes the covered functions to a text file.#"
+	"Export coverage:R>\n"
+	"<#Colors the covered functions in the disassembly.#"
+	"Color covered functions:R>\n"
+	"<#Restores the colors changed by the previous command.#"
+	"Remove coverage colors:R>\n"
+	"<#Writes the covered basic blocks to a drcov file (Lighthouse etc.).#"
+	"Export block coverage (drcov):R>\n"
+	"<#Colors functions and basic blocks by their hits (log scale).#"
+	"Show heatmap:R>\n"
+	"<#Restores the colors changed by the previous command.#"
+	"Remove heatmap:R>\n"
+	"<#Shows the caller -> callee edges of the last run.#"
+	"Show call graph:R>\n"
+	"<#Writes the call graph to a .dot or .gml file.#"
+	"Export call graph:R>\n"
+	"<#Writes the profile of the last run to a .vpf file.#"
+	"Save profile:R>\n"
+	"<#Shows a saved profile.#"
+	"Load profile:R>\n"
+	"<#Sums up all profiles matching a wildcard pattern.#"
+	"Merge profiles:R>\n"
+	"<#Lists the functions whose hits per run changed.#"
+	"Diff two profiles:R>\n"
+	"<#Removes the breakpoints VSCP has set, nothing else.#"
+	"Delete profiling breakpoints:R>>\n\n"
+	;
 
 bool profile=true;
+int mode=MODE_HITS;
+int command=CMD_DELETE;
+sval_t smp_interval=SMP_DEFAULT_INTERVAL;
+sval_t smp_depth=SMP_DEFAULT_DEPTH;
+bool b_callers=true;
+UINT_PTR refresh_timer=0;
 
-static int idaapi dbg_callback(void * /*user_data*/, int event_id, va_list /*va*/)
+static void CALLBACK refresh_proc(HWND /*hwnd*/, UINT /*msg*/, UINT_PTR /*id*/, DWORD /*time*/)
 {
-	regval_t eip;
-	int numfuncs;
-	int i;
-	func_t *f;
-	bpt_t cur_bp;
+	prof_refresh();
+}
+
+static void stop_refresh(void)
+{
+	if(refresh_timer != 0)
+	{
+		KillTimer(NULL, refresh_timer);
+		refresh_timer = 0;
+	}
+}
+
+static int idaapi dbg_callback(void * /*user_data*/, int event_id, va_list va)
+{
+	const debug_event_t *ev;
+	char path[QMAXPATH];
+	thid_t tid;
+	ea_t ea;
+	size_t qty;
+	eavec_t eas;
+	short checkbox;
+	scope_t scope;
 
 	//is the process about to start?
 	if(event_id==dbg_process_start)
 	{
-		if( askyn_cv(1,"VSCP - Want to profile the process?",0) !=1)
+		ev = va_arg(va, const debug_event_t *);
+		checkbox = (short)b_callers;
+		scope_load(scope);
+		if( AskUsingForm_c(start_dlg,&mode,&smp_interval,&smp_depth,&checkbox,
+			scope.segments,scope.ranges,scope.include,scope.exclude,&scope.flags) != 1)
 		{
-			//only profile, if user clicked "yes"
+			//only profile, if user clicked "ok"
 			profile=false;
 			return 0;
 		}
 		else profile=true;
-		
-		//get number of total functions from the idb
-		numfuncs=get_func_qty();
+		b_callers = (checkbox & 1) != 0;
+		scope_save(scope);
 
-		msg("Setting %d breakpoints, please wait..",numfuncs);
+		if(mode == MODE_SAMPLE)
+		{
+			if( !smp_start(ev->pid, smp_interval, smp_depth) )
+				profile=false;
+			else
+				smp_add_thread(ev->tid);
+			return 0;
+		}
+		
+		if( !scope_build(scope) )
+		{
+			profile=false;
+			return 0;
+		}
 
-		//set breakpoint on each function, with flagtype = BPT_TRACE
+		//collect the function entries in scope first, then set all
+		//breakpoints at once with flagtype = BPT_TRACE.
 		//these are breakpoints which don't suspend the debugger
-		for (i=0;i<=numfuncs-1;i++)
+		eas.reserve(get_func_qty());
+		qty = scope_collect(eas);
+		msg("VSCP: %u of %d functions in scope.\n",(ulong)qty,get_func_qty());
+		if(mode == MODE_BLOCKS)
+		{
+			eavec_t funcs;
+			funcs.swap(eas);
+			if( !bbc_reset(funcs, eas) )
+			{
+				profile=false;
+				return 0;
+			}
+			qty = eas.size();
+		}
+
+		msg("Setting %u breakpoints, please wait..",(ulong)qty);
+		qty = bpts_install(eas, BPT_TRACE);
+		msg("done, %u set!\n", (ulong)qty);
+
+		//eas now holds exactly the functions with a VSCP breakpoint
+		if(mode == MODE_COVER)
 		{
-			f = getn_func(i);
-			add_bpt(f->startEA,0,-1);
-			getn_bpt(i, &cur_bp);
-			cur_bp.flags=BPT_TRACE;
-			update_bpt(&cur_bp);
+			cov_reset(eas);
+			return 0;
 		}
-		msg("done!\n");
+		if(mode == MODE_BLOCKS)
+			return 0;
+		prof_reset(eas);
+		cg_reset();
+		tm_reset();
+		prof_show();
+		if(refresh_timer == 0)
+			refresh_timer = SetTimer(NULL, 0, REFRESH_INTERVAL, refresh_proc);
+	}
+
+	//the sampler needs to know all threads
+	else if(event_id==dbg_thread_start && profile && mode == MODE_SAMPLE)
+	{
+		ev = va_arg(va, const debug_event_t *);
+		smp_add_thread(ev->tid);
+	}
+	else if(event_id==dbg_thread_exit && profile && mode == MODE_SAMPLE)
+	{
+		ev = va_arg(va, const debug_event_t *);
+		smp_del_thread(ev->tid);
+	}
+	else if(event_id==dbg_thread_exit && profile && mode == MODE_TIME)
+	{
+		ev = va_arg(va, const debug_event_t *);
+		tm_thread_exit(ev->tid);
 	}
 
 	//this code makes sure that the process is being
 	//resumed if a breakpoint triggers, which the user didnt set
-	else if(event_id==dbg_breakpoint && profile)
+	else if(event_id==dbg_breakpoint && profile && mode != MODE_SAMPLE)
 	{
-		continue_process();
+		tid = va_arg(va, thid_t);
+		ea = va_arg(va, ea_t);
+		if(mode == MODE_TIME)
+		{
+			if( tm_event(tid, ea, prof_hit(ea), b_callers) || bpts_owned(ea) )
+				continue_process();
+		}
+		else if(mode == MODE_COVER || mode == MODE_BLOCKS)
+		{
+			//one-shot: the function (block) is covered, the breakpoint has done its job
+			if( (mode == MODE_COVER ? cov_hit(ea) : bbc_hit(ea)) && bpts_owned(ea) )
+			{
+				del_bpt(ea);
+				bpts_forget(ea);
+				continue_process();
+			}
+		}
+		else if( prof_hit(ea) )
+		{
+			if(b_callers)
+				cg_record(ea);
+			continue_process();
+		}
+		else if( bpts_owned(ea) )
+			continue_process();
 	}
 
 	//Notify the user to clear the breakpoints if he doesn't need them
 	//anymore
+	else if(event_id==dbg_process_exit && profile && mode == MODE_SAMPLE)
+	{
+		set_file_ext(path, sizeof(path), database_idb, "folded");
+		smp_stop(path);
+		runs_autosave();
+		prof_show();
+	}
+	else if(event_id==dbg_process_exit && profile && mode == MODE_COVER)
+	{
+		//the remaining breakpoints belong to functions that didn't run
+		bpts_remove();
+		msg("Process terminated, %u of %u functions covered.\n"
+			"Press alt-8 to export or color them.\n",
+			(ulong)cov_covered(), (ulong)cov_qty());
+	}
+	else if(event_id==dbg_process_exit && profile && mode == MODE_BLOCKS)
+	{
+		bpts_remove();
+		msg("Process terminated, %u of %u basic blocks covered.\n"
+			"Press alt-8 to export them.\n",
+			(ulong)bbc_covered(), (ulong)bbc_qty());
+	}
 	else if(event_id==dbg_process_exit && profile)
 	{
+		if(mode == MODE_TIME)
+		{
+			tm_stop();
+			msg("VSCP: %u return sites were timed.\n", (ulong)tm_return_sites());
+		}
+		stop_refresh();
+		prof_refresh();
+		runs_autosave();
 		msg(
-			"Process terminated.. be sure to check out the breakpoint list!\n"
-			"Press alt-8 to delete the breakpoint list.\n"
+			"Process terminated after %.0f breakpoint hits.. be sure to check out the profile!\n"
+			"Press alt-8 to delete the breakpoints.\n",
+			(double)prof_total()
 			);
 	}
 
@@ -92,33 +371,147 @@ int idaapi init(void)
 
 void idaapi term(void)
 {
+	char path[QMAXPATH];
+
 	//unregister callback
+	stop_refresh();
+	cg_term();
+	if(smp_active())
+		smp_stop(set_file_ext(path, sizeof(path), database_idb, "folded"));
 	unhook_from_notification_point(HT_DBG, dbg_callback);
 }
 
 void idaapi run(int arg)
 {
-	int numfuncs;
-	int i;
-	func_t *f;
-	numfuncs=get_func_qty();
+	char pattern[QMAXPATH];
+	char path[QMAXPATH];
+	char *answer;
+
+	if(arg == 1)
+	{
+		prof_show();
+		return;
+	}
 
 	//this function will be run if the user presses alt-8
 	//or selects the plugin from the menu
-	//it deletes all the breakpoints and clears the bp-list
-	msg("Deleting %d breakpoints, please wait..",numfuncs);
-	for (i=0;i<=numfuncs-1;i++)
+	if( AskUsingForm_c(cmd_dlg,&command) != 1)
+		return;
+
+	switch(command)
 	{
-		f = getn_func(i);
-		del_bpt(f->startEA);
+	case CMD_PROFILE:
+		prof_show();
+		break;
+	case CMD_COVER_EXPORT:
+		if(cov_covered() == 0)
+		{
+			msg("VSCP: nothing covered yet.\n");
+			break;
+		}
+		answer = askfile_c(1,"*.txt","Enter a filename for the coverage:");
+		if(answer == NULL)
+			break;
+		if(cov_export(answer))
+			msg("VSCP: %u functions written to %s\n",(ulong)cov_covered(),answer);
+		else
+			msg("VSCP: could not write %s\n",answer);
+		break;
+	case CMD_COVER_PAINT:
+		heat_unpaint();
+		cov_paint();
+		break;
+	case CMD_COVER_UNPAINT:
+		cov_unpaint();
+		break;
+	case CMD_BLOCKS_EXPORT:
+		if(bbc_covered() == 0)
+		{
+			msg("VSCP: no basic blocks covered yet.\n");
+			break;
+		}
+		answer = askfile_c(1,"*.drcov","Enter a filename for the block coverage:");
+		if(answer == NULL)
+			break;
+		if(bbc_export(answer))
+			msg("VSCP: %u blocks written to %s\n",(ulong)bbc_covered(),answer);
+		else
+			msg("VSCP: could not write %s\n",answer);
+		break;
+	case CMD_HEAT_PAINT:
+		if(heat_build() == 0)
+		{
+			msg("VSCP: no profile or coverage to show.\n");
+			break;
+		}
+		cov_unpaint();
+		heat_paint();
+		break;
+	case CMD_HEAT_UNPAINT:
+		heat_unpaint();
+		break;
+	case CMD_CALLGRAPH:
+		cg_show();
+		break;
+	case CMD_CALLGRAPH_EXPORT:
+		if(cg_qty() == 0)
+		{
+			msg("VSCP: no calls recorded yet.\n");
+			break;
+		}
+		answer = askfile_c(1,"*.dot","Enter a filename for the call graph (.dot or .gml):");
+		if(answer == NULL)
+			break;
+		if(cg_export(answer))
+			msg("VSCP: %u edges written to %s\n",(ulong)cg_qty(),answer);
+		else
+			msg("VSCP: could not write %s\n",answer);
+		break;
+	case CMD_SAVE:
+		answer = askfile_c(1,"*.vpf","Enter a filename for the profile:");
+		if(answer != NULL)
+			runs_save(answer);
+		break;
+	case CMD_LOAD:
+		answer = askfile_c(0,"*.vpf","Select a profile:");
+		if(answer != NULL)
+			runs_load(answer);
+		break;
+	case CMD_MERGE:
+		set_file_ext(pattern, sizeof(pattern), database_idb, "*.vpf");
+		answer = askstr(HIST_FILE, pattern, "Profiles to merge (wildcards allowed)");
+		if(answer == NULL)
+			break;
+		qstrncpy(pattern, answer, sizeof(pattern));
+		answer = askfile_c(1,"*.vpf","Enter a filename for the merged profile:");
+		if(answer != NULL)
+			runs_merge(pattern, answer);
+		break;
+	case CMD_DIFF:
+		answer = askfile_c(0,"*.vpf","Select the first (baseline) profile:");
+		if(answer == NULL)
+			break;
+		qstrncpy(pattern, answer, sizeof(pattern));
+		answer = askfile_c(0,"*.vpf","Select the second profile:");
+		if(answer == NULL)
+			break;
+		qstrncpy(path, answer, sizeof(path));
+		answer = askstr(HIST_IDENT, "2", "Minimum change factor");
+		if(answer != NULL)
+			runs_diff(pattern, path, atof(answer));
+		break;
+	case CMD_DELETE:
+		//it deletes the breakpoints VSCP has set, nothing else
+		msg("Deleting %u breakpoints, please wait..",(ulong)bpts_qty());
+		msg("done, %u deleted!\n",(ulong)bpts_remove());
+		break;
 	}
-	msg("done!\n");
 }
 
 //--------------------------------------------------------------------------
 char comment[] = "VSCP";
 char help[] = "VSCP\n";
-char wanted_name[] = "VSCP - Erase all profiling breakpoints";
+char wanted_name[] = "VSCP - Profile, coverage and breakpoints";
 char wanted_hotkey[] = "Alt-8";
 
 plugin_t PLUGIN =